@@ -0,0 +1,74 @@
+#type vertex
+#version 430 core
+layout (location=0) in vec3 aPos;
+layout (location=1) in vec2 aScale;
+layout (location=2) in vec4 aTexRect; // top-right u/v, bottom-left u/v
+layout (location=3) in vec4 aColor;
+layout (location=4) in uint aPacked; // texture slot (bits 0-7) | shape (bits 8-15) | rotation in turns (bits 16-31)
+
+// written once per frame by Renderer::flush
+layout (std140, binding = FRAME_BINDING) uniform Frame {
+    mat4 uWorldProjection;
+    mat4 uView;
+    float uTime;
+};
+
+out vec4 fColor;
+out vec2 fTexCoords;
+flat out int fTexId;
+flat out int fShapeType;
+
+void main()
+{
+    // triangle strip over the corners (0, 0), (1, 0), (0, 1), (1, 1)
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec2 local = (corner - 0.5) * aScale;
+
+    float radians = float(aPacked >> 16) / 65536.0 * 6.28318530718;
+    if (radians != 0.0) {
+        float c = cos(radians);
+        float s = sin(radians);
+        local = mat2(c, -s, s, c) * local;
+    }
+
+    fColor = aColor;
+    fTexCoords = vec2(mix(aTexRect.z, aTexRect.x, corner.x), mix(aTexRect.w, aTexRect.y, corner.y));
+    fTexId = int(aPacked & 0xFFu);
+    fShapeType = int((aPacked >> 8) & 0xFFu);
+
+    gl_Position = uWorldProjection * uView * vec4(aPos.xy + local, aPos.z, 1.0);
+}
+
+#type fragment
+#version 430 core
+#ifdef BINDLESS_TEXTURES
+#extension GL_ARB_bindless_texture : require
+#endif
+
+in vec4 fColor;
+in vec2 fTexCoords;
+flat in int fTexId;
+flat in int fShapeType;
+
+#ifdef BINDLESS_TEXTURES
+layout (bindless_sampler) uniform sampler2D uTextures[MAX_TEXTURE_SLOTS];
+#else
+uniform sampler2D uTextures[MAX_TEXTURE_SLOTS];
+#endif
+
+out vec4 color;
+
+void main() {
+
+    if (fShapeType == 3) {
+        // SDF glyph (Shape::SDF_TEXT): the outline is at 0.5, smoothed over about one screen pixel whatever the text size
+        float distance = texture(uTextures[fTexId], fTexCoords).a;
+        float width = fwidth(distance);
+        color = vec4(fColor.rgb, fColor.a * smoothstep(0.5 - width, 0.5 + width, distance));
+    } else if (fTexId > 0) {
+        color = fColor * texture(uTextures[fTexId], fTexCoords);
+    } else {
+        color = fColor;
+    }
+
+}
@@ -3,44 +3,58 @@
 layout (location=0) in vec3 aPos;
 layout (location=1) in vec4 aColor;
 layout (location=2) in vec2 aTexCoords;
-layout (location=3) in float aTexId;
-layout (location=4) in float aShapeType;
+layout (location=3) in uint aPacked; // texture slot (bits 0-7) | shape (bits 8-15) | flags (bits 16-31)
 
-uniform mat4 uWorldProjection;
-uniform mat4 uView;
+// written once per frame by Renderer::flush
+layout (std140, binding = FRAME_BINDING) uniform Frame {
+    mat4 uWorldProjection;
+    mat4 uView;
+    float uTime;
+};
 
 out vec4 fColor;
 out vec2 fTexCoords;
-out float fTexId;
-out float fShapeType;
+flat out int fTexId;
+flat out int fShapeType;
 
 void main()
 {
     fColor = aColor;
     fTexCoords = aTexCoords;
-    fTexId = aTexId;
-    fShapeType = aShapeType;
+    fTexId = int(aPacked & 0xFFu);
+    fShapeType = int((aPacked >> 8) & 0xFFu);
 
     gl_Position = uWorldProjection * uView * vec4(aPos, 1.0);
 }
 
 #type fragment
 #version 430 core
+#ifdef BINDLESS_TEXTURES
+#extension GL_ARB_bindless_texture : require
+#endif
 
 in vec4 fColor;
 in vec2 fTexCoords;
-in float fTexId;
-in float fShapeType;
+flat in int fTexId;
+flat in int fShapeType;
 
-uniform sampler2D uTextures[16];
+#ifdef BINDLESS_TEXTURES
+layout (bindless_sampler) uniform sampler2D uTextures[MAX_TEXTURE_SLOTS];
+#else
+uniform sampler2D uTextures[MAX_TEXTURE_SLOTS];
+#endif
 
 out vec4 color;
 
 void main() {
 
-    if (fTexId > 0) {
-        int id = int(fTexId);
-        color = fColor * texture(uTextures[id], fTexCoords);
+    if (fShapeType == 3) {
+        // SDF glyph (Shape::SDF_TEXT): the outline is at 0.5, smoothed over about one screen pixel whatever the text size
+        float distance = texture(uTextures[fTexId], fTexCoords).a;
+        float width = fwidth(distance);
+        color = vec4(fColor.rgb, fColor.a * smoothstep(0.5 - width, 0.5 + width, distance));
+    } else if (fTexId > 0) {
+        color = fColor * texture(uTextures[fTexId], fTexCoords);
     } else {
         color = fColor;
     }
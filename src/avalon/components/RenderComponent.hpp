@@ -4,16 +4,15 @@
 #include "avalon/entity/Actor.hpp"
 #include "avalon/scene/Layer.hpp"
 #include "avalon/utils/AssetPool.hpp"
+#include "avalon/renderer/Shape.hpp"
 
 #include <glm/glm.hpp>
 
-enum Shape {
-    QUAD,
-    TEXT
-};
-
 NLOHMANN_JSON_SERIALIZE_ENUM( Shape, {
-    {QUAD, "quad"}
+    {QUAD, "quad"},
+    {CIRCLE, "circle"},
+    {TEXT, "text"},
+    {SDF_TEXT, "sdf_text"}
 })
 
 class RenderComponent : public Component {
@@ -0,0 +1,94 @@
+#include "JobSystem.hpp"
+
+JobSystem::JobSystem(uint32_t workerCount) {
+    for (uint32_t i = 0; i <= workerCount; i++)
+        queues.push_back(CreateScope<Queue>());
+
+    for (uint32_t i = 1; i <= workerCount; i++)
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        running = false;
+    }
+    wakeCondition.notify_all();
+
+    for (auto &worker: workers)
+        worker.join();
+}
+
+JobSystem &JobSystem::getInstance() {
+    static JobSystem instance(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    return instance;
+}
+
+void JobSystem::submit(Job job, Counter &counter) {
+    counter.pending++;
+
+    Queue &queue = *queues[threadIndex < queues.size() ? threadIndex : 0];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back({std::move(job), &counter});
+    }
+    queued++;
+
+    // taking the lock orders the notification after a sleeping worker checked `queued`
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    wakeCondition.notify_one();
+}
+
+void JobSystem::wait(Counter &counter) {
+    while (counter.pending > 0) {
+        if (!tryRunJob(threadIndex))
+            std::this_thread::yield();
+    }
+}
+
+bool JobSystem::tryRunJob(uint32_t self) {
+    Task task;
+    bool found = false;
+
+    // newest job of our own queue first, it is the most likely to be warm in cache
+    {
+        Queue &own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            found = true;
+        }
+    }
+
+    // otherwise steal the oldest job of another thread
+    for (uint32_t i = 1; !found && i < queues.size(); i++) {
+        Queue &victim = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            found = true;
+        }
+    }
+
+    if (!found)
+        return false;
+
+    queued--;
+    task.job();
+    task.counter->pending--;
+    return true;
+}
+
+void JobSystem::workerLoop(uint32_t index) {
+    threadIndex = index;
+
+    while (running) {
+        if (tryRunJob(index))
+            continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeCondition.wait(lock, [this]() { return queued > 0 || !running; });
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Core.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+/**
+ * Work-stealing thread pool. Every thread (the workers plus the thread that owns the pool) has its own
+ * queue: a thread pushes and pops jobs at the back of its queue, idle threads steal from the front of
+ * the others. Waiting on a counter does not block the caller, it keeps executing jobs until the
+ * counter drops to zero, so jobs may themselves submit and wait for more jobs.
+ */
+class JobSystem {
+public:
+    using Job = std::function<void()>;
+
+    /**
+     * Tracks the number of unfinished jobs of a submission.
+     */
+    struct Counter {
+        std::atomic<uint32_t> pending = 0;
+    };
+
+    explicit JobSystem(uint32_t workerCount);
+
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    /**
+     * Shared pool with one worker per hardware thread besides the main thread.
+     */
+    static JobSystem &getInstance();
+
+    void submit(Job job, Counter &counter);
+
+    void wait(Counter &counter);
+
+    /**
+     * Splits [0, count) in chunks of at most grainSize elements and calls func(begin, end) for each
+     * chunk on the pool, returning once every chunk has been processed.
+     */
+    template<typename Func>
+    void parallelFor(std::size_t count, std::size_t grainSize, Func &&func) {
+        grainSize = std::max<std::size_t>(grainSize, 1);
+
+        if (workers.empty() || count <= grainSize) {
+            if (count > 0)
+                func(std::size_t(0), count);
+            return;
+        }
+
+        Counter counter;
+        for (std::size_t begin = 0; begin < count; begin += grainSize) {
+            std::size_t end = std::min(begin + grainSize, count);
+            submit([&func, begin, end]() { func(begin, end); }, counter);
+        }
+
+        wait(counter);
+    }
+
+    /**
+     * Number of threads executing jobs, the owning thread included.
+     */
+    uint32_t getThreadCount() const {
+        return static_cast<uint32_t>(queues.size());
+    }
+
+    /**
+     * Index of the calling thread in [0, getThreadCount()). Worker i has index i + 1, any other thread
+     * reports 0.
+     */
+    static uint32_t getThreadIndex() {
+        return threadIndex;
+    }
+
+private:
+    struct Task {
+        Job job;
+        Counter *counter;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool tryRunJob(uint32_t self);
+
+    void workerLoop(uint32_t index);
+
+    std::vector<Scope<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::atomic<bool> running = true;
+    std::atomic<uint32_t> queued = 0;
+    std::mutex sleepMutex;
+    std::condition_variable wakeCondition;
+
+    inline static thread_local uint32_t threadIndex = 0;
+};
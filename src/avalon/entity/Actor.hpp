@@ -2,24 +2,49 @@
 
 #include "Component.hpp"
 
-using ActorId = std::size_t;
+/**
+ * Actor handle: the low 32 bits index the actor's slot in the registry, the high 32 bits hold the
+ * slot's generation. Destroyed slots are recycled with a bumped generation, so stale handles to a
+ * reused slot can be told apart with a single compare.
+ */
+using ActorId = uint64_t;
+
+constexpr ActorId NullActorId = UINT64_MAX;
+
+constexpr ActorId makeActorId(uint32_t index, uint32_t generation) {
+    return (static_cast<ActorId>(generation) << 32) | index;
+}
+
+constexpr uint32_t actorIndex(ActorId id) {
+    return static_cast<uint32_t>(id);
+}
+
+constexpr uint32_t actorGeneration(ActorId id) {
+    return static_cast<uint32_t>(id >> 32);
+}
 
 class Registry;
 
 class Actor {
 public:
 
+    Actor() : id(NullActorId), parentRegistry(nullptr) {}
+
     Actor(ActorId id, Registry* registry) : id(id), parentRegistry(registry) {}
 
     /**
-     * Adds an component to the object. Note that the duplicates are not allowed.
+     * Adds an component to the object. Note that the duplicates are not allowed, adding a component
+     * the actor already has replaces it.
      */
     template<typename T, typename... Args>
-    void addComponent(Args &&... args);
+    T &addComponent(Args &&... args);
 
     template<typename T>
     T *getComponent() const;
 
+    template<typename T>
+    bool hasComponent() const;
+
     template<typename T>
     void removeComponent();
 
@@ -27,25 +52,30 @@ public:
         return this->id;
     }
 
-    bool isValid() const {
-        return parentRegistry != nullptr;
-    }
+    /**
+     * False for default constructed handles and for handles whose actor has been destroyed.
+     */
+    bool isValid() const;
 
     friend void to_json(json &j, const Actor& actor);
 
     friend void from_json(const json *j, Actor& actor);
 
+    bool operator==(const Actor &other) const {
+        return id == other.id && parentRegistry == other.parentRegistry;
+    }
+
 private:
+    // components live in the parent registry's pools, an actor is only a handle
     ActorId id;
     Registry* parentRegistry;
-    std::unordered_map<std::type_index, std::shared_ptr<Component>> components;
 };
 
 namespace std {
     template<>
     struct hash<Actor> {
         std::size_t operator()(const Actor& actor) const noexcept {
-            return std::hash<int>()(actor.getId());
+            return std::hash<ActorId>()(actor.getId());
         }
     };
 }
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Registry.hpp"
+
+#include <optional>
+
+/**
+ * Records structural changes (create/destroy actors, add/remove components) so they can be made while
+ * views are being iterated or from job system threads, and applies them later in one batch with
+ * Registry::flushCommands. Every job system thread records into its own buffer, see
+ * Registry::getCommandBuffer.
+ *
+ * Playback groups the commands by kind: actors are created first, then the additions and removals of
+ * each component type are replayed in the order they were recorded, and actors are destroyed last.
+ */
+class CommandBuffer {
+public:
+
+    /**
+     * Reserves an actor created on playback. The returned id is a placeholder that is only meaningful
+     * to this buffer: it can be passed to its other methods until the next flush.
+     */
+    ActorId createActor() {
+        return makeActorId(createdCount++, PendingGeneration);
+    }
+
+    void destroyActor(ActorId id) {
+        destroyed.push_back(id);
+    }
+
+    template<typename T, typename... Args>
+    void addComponent(ActorId id, Args &&... args) {
+        auto &commands = commandsOf<T>();
+        commands.commands.push_back({id, T(std::forward<Args>(args)...)});
+        commands.additions++;
+    }
+
+    template<typename T>
+    void removeComponent(ActorId id) {
+        commandsOf<T>().commands.push_back({id, std::nullopt});
+    }
+
+    bool empty() const {
+        return createdCount == 0 && destroyed.empty() && !hasComponentCommands;
+    }
+
+    void playback(Registry &registry) {
+        if (empty())
+            return;
+
+        created.clear();
+        created.reserve(createdCount);
+        for (uint32_t i = 0; i < createdCount; i++)
+            created.push_back(registry.createActor().getId());
+
+        for (auto &commands: components) {
+            if (commands)
+                commands->apply(registry, *this);
+        }
+
+        for (auto id: destroyed)
+            registry.destroyActor(Actor(resolve(id), &registry));
+
+        createdCount = 0;
+        destroyed.clear();
+        hasComponentCommands = false;
+    }
+
+private:
+    static constexpr uint32_t PendingGeneration = UINT32_MAX;
+
+    struct ComponentCommandsBase {
+        virtual ~ComponentCommandsBase() = default;
+
+        virtual void apply(Registry &registry, const CommandBuffer &buffer) = 0;
+    };
+
+    template<typename T>
+    struct ComponentCommands : ComponentCommandsBase {
+        struct Command {
+            ActorId id;
+            std::optional<T> component; // empty for a removal
+        };
+
+        // one list so that adding then removing a component, or the reverse, keeps its meaning
+        std::vector<Command> commands;
+        std::size_t additions = 0;
+
+        void apply(Registry &registry, const CommandBuffer &buffer) override {
+            if (additions > 0) {
+                // grow the pool once for the whole batch
+                auto &pool = registry.getPool<T>();
+                pool.reserve(pool.size() + additions);
+            }
+
+            for (auto &[id, component]: commands) {
+                ActorId actor = buffer.resolve(id);
+                if (!component)
+                    registry.removeComponent<T>(actor);
+                else if (registry.isValid(actor))
+                    registry.addComponent<T>(actor, std::move(*component));
+            }
+
+            commands.clear();
+            additions = 0;
+        }
+    };
+
+    template<typename T>
+    ComponentCommands<T> &commandsOf() {
+        uint32_t type = ComponentType::id<T>();
+        if (type >= components.size())
+            components.resize(type + 1);
+
+        if (!components[type])
+            components[type] = CreateScope<ComponentCommands<T>>();
+
+        hasComponentCommands = true;
+        return static_cast<ComponentCommands<T> &>(*components[type]);
+    }
+
+    ActorId resolve(ActorId id) const {
+        return actorGeneration(id) == PendingGeneration ? created[actorIndex(id)] : id;
+    }
+
+    uint32_t createdCount = 0;
+    std::vector<ActorId> created; // placeholder index -> real id, filled on playback
+    std::vector<ActorId> destroyed;
+    std::vector<Scope<ComponentCommandsBase>> components; // indexed by ComponentType::id
+    bool hasComponentCommands = false;
+};
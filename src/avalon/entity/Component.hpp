@@ -2,7 +2,9 @@
 
 #include "avalon/core/Core.hpp"
 
+/**
+ * Marker base for components. Components are stored by value in the registry's pools, so this
+ * deliberately has no virtual destructor - deriving from it adds no vtable or per-instance cost.
+ */
 class Component {
-public:
-    virtual ~Component() {};
 };
@@ -0,0 +1,264 @@
+#pragma once
+
+#include "Actor.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+/**
+ * Hands out a small, dense index for every component type. Registries use it to address their pools
+ * with a plain array lookup instead of hashing a std::type_index.
+ */
+class ComponentType {
+public:
+
+    template<typename T>
+    static uint32_t id() {
+        static const uint32_t typeId = nextId.fetch_add(1);
+        return typeId;
+    }
+
+private:
+    inline static std::atomic<uint32_t> nextId = 0;
+};
+
+/**
+ * View filter matching the actors whose T component changed after the view's tick. Changes are the
+ * tick stamps written by Registry::addComponent, Registry::patch and Registry::markChanged.
+ *
+ * registry.view<Changed<RenderComponent>>(lastRebuildTick).each([](RenderComponent &render) { ... });
+ */
+template<typename T>
+struct Changed {
+};
+
+template<typename T>
+struct ComponentTraits {
+    using Type = T;
+    static constexpr bool changedOnly = false;
+};
+
+template<typename T>
+struct ComponentTraits<Changed<T>> {
+    using Type = T;
+    static constexpr bool changedOnly = true;
+};
+
+// component type handed out for a view parameter, i.e. T for both T and Changed<T>
+template<typename T>
+using ComponentOf = typename ComponentTraits<T>::Type;
+
+/**
+ * Receives structural changes of the pools it owns, see Registry::Group.
+ */
+class GroupBase {
+public:
+    explicit GroupBase(std::vector<uint32_t> ownedTypes) : types(std::move(ownedTypes)) {
+        std::sort(types.begin(), types.end());
+    }
+
+    virtual ~GroupBase() = default;
+
+    // called after a component of an owned type was added to the actor
+    virtual void onConstruct(ActorId id) = 0;
+
+    // called before a component of an owned type is removed from the actor
+    virtual void onDestroy(ActorId id) = 0;
+
+    // ComponentType ids of the owned types, sorted
+    const std::vector<uint32_t> &getTypes() const {
+        return types;
+    }
+
+    // number of actors packed at the front of the owned pools
+    uint32_t size() const {
+        return length;
+    }
+
+protected:
+    uint32_t length = 0;
+
+private:
+    std::vector<uint32_t> types;
+};
+
+/**
+ * Receives the changes of one component type, see Registry::observe. Unlike groups, any number of
+ * observers can watch a pool. They are called on the thread making the change, so an observed type
+ * must not be changed from several threads at once.
+ */
+class ComponentObserver {
+public:
+    virtual ~ComponentObserver() = default;
+
+    // called after the component was added to the actor, or replaced by Registry::addComponent
+    virtual void onConstruct(ActorId id) = 0;
+
+    // called after Registry::markChanged or Registry::patch
+    virtual void onUpdate(ActorId id) = 0;
+
+    // called before the component is removed, including when the actor is destroyed
+    virtual void onDestroy(ActorId id) = 0;
+};
+
+/**
+ * Type-erased part of a component pool. It owns the sparse set that maps an actor to its slot in the
+ * packed arrays, so the registry can test and remove components without knowing their type.
+ */
+class ComponentPoolBase {
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    virtual ~ComponentPoolBase() = default;
+
+    virtual void remove(ActorId id) = 0;
+
+    /**
+     * Exchanges the entries at two positions of the packed arrays, keeping the sparse index in sync.
+     */
+    virtual void swapEntries(uint32_t a, uint32_t b) = 0;
+
+    bool contains(ActorId id) const {
+        uint32_t index = actorIndex(id);
+        return index < sparse.size() && sparse[index] != npos && actors[sparse[index]] == id;
+    }
+
+    /**
+     * Position of the actor's component in the packed arrays. Only valid if contains(id) is true.
+     */
+    uint32_t indexOf(ActorId id) const {
+        return sparse[actorIndex(id)];
+    }
+
+    std::size_t size() const {
+        return actors.size();
+    }
+
+    bool empty() const {
+        return actors.empty();
+    }
+
+    const std::vector<ActorId> &getActors() const {
+        return actors;
+    }
+
+    GroupBase *getOwner() const {
+        return owner;
+    }
+
+    void setOwner(GroupBase *group) {
+        owner = group;
+    }
+
+    const std::vector<ComponentObserver *> &getObservers() const {
+        return observers;
+    }
+
+    void addObserver(ComponentObserver *observer) {
+        observers.push_back(observer);
+    }
+
+    void removeObserver(ComponentObserver *observer) {
+        std::erase(observers, observer);
+    }
+
+protected:
+    GroupBase *owner = nullptr; // group keeping this pool sorted, if any
+    std::vector<ComponentObserver *> observers;
+
+    std::vector<uint32_t> sparse; // actor index -> index in the packed arrays
+    std::vector<ActorId> actors;  // packed array of the actors owning a component
+};
+
+/**
+ * Sparse set holding every component of type T contiguously. Insertion, lookup and removal are O(1);
+ * removal swaps the last element into the freed slot so the arrays stay packed.
+ */
+template<typename T>
+class ComponentPool : public ComponentPoolBase {
+public:
+
+    template<typename... Args>
+    T &emplace(ActorId id, Args &&... args) {
+        if (contains(id)) {
+            T &component = components[indexOf(id)];
+            component = T(std::forward<Args>(args)...);
+            return component;
+        }
+
+        uint32_t actor = actorIndex(id);
+        if (actor >= sparse.size())
+            sparse.resize(actor + 1, npos);
+
+        sparse[actor] = static_cast<uint32_t>(actors.size());
+        actors.push_back(id);
+        ticks.push_back(0);
+        return components.emplace_back(std::forward<Args>(args)...);
+    }
+
+    void remove(ActorId id) override {
+        if (!contains(id))
+            return;
+
+        uint32_t index = indexOf(id);
+        uint32_t last = static_cast<uint32_t>(actors.size() - 1);
+
+        if (index != last) {
+            ActorId moved = actors[last];
+            actors[index] = moved;
+            components[index] = std::move(components[last]);
+            ticks[index] = ticks[last];
+            sparse[actorIndex(moved)] = index;
+        }
+
+        actors.pop_back();
+        components.pop_back();
+        ticks.pop_back();
+        sparse[actorIndex(id)] = npos;
+    }
+
+    void swapEntries(uint32_t a, uint32_t b) override {
+        if (a == b)
+            return;
+
+        std::swap(actors[a], actors[b]);
+        std::swap(components[a], components[b]);
+        std::swap(ticks[a], ticks[b]);
+        sparse[actorIndex(actors[a])] = a;
+        sparse[actorIndex(actors[b])] = b;
+    }
+
+    void reserve(std::size_t capacity) {
+        actors.reserve(capacity);
+        components.reserve(capacity);
+        ticks.reserve(capacity);
+    }
+
+    T *get(ActorId id) {
+        return contains(id) ? &components[indexOf(id)] : nullptr;
+    }
+
+    const T *get(ActorId id) const {
+        return contains(id) ? &components[indexOf(id)] : nullptr;
+    }
+
+    std::vector<T> &getComponents() {
+        return components;
+    }
+
+    /**
+     * Registry tick at which the component at the given position was last added or changed.
+     */
+    uint32_t getChangedTick(uint32_t index) const {
+        return ticks[index];
+    }
+
+    void markChanged(ActorId id, uint32_t tick) {
+        if (contains(id))
+            ticks[indexOf(id)] = tick;
+    }
+
+private:
+    std::vector<T> components; // packed in the same order as `actors`
+    std::vector<uint32_t> ticks; // change stamps, packed in the same order as `actors`
+};
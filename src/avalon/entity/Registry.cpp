@@ -1,33 +1,56 @@
 #include "Registry.hpp"
+#include "CommandBuffer.hpp"
+
+Registry::Registry() {
+    for (uint32_t i = 0; i < JobSystem::getInstance().getThreadCount(); i++)
+        commandBuffers.push_back(CreateScope<CommandBuffer>());
+}
+
+Registry::~Registry() = default;
 
 Actor Registry::createActor() {
-    ActorId id = nextEntityID++;
-    Actor entity(id, this);
-    entities.emplace(id, entity);
-    return entity;
+    ActorId id;
+
+    if (!freeSlots.empty()) {
+        // recycle the most recently freed slot, its stored id already carries the bumped generation
+        id = slots[freeSlots.back()];
+        freeSlots.pop_back();
+    } else {
+        id = makeActorId(static_cast<uint32_t>(slots.size()), 0);
+        slots.push_back(id);
+    }
+
+    return {id, this};
 }
 
 void Registry::destroyActor(const Actor& entity) {
-    entities.erase(entity.getId());
-}
+    ActorId id = entity.getId();
+    if (!isValid(id))
+        return;
 
-template<typename... Components>
-auto Registry::View<Components...>::each() const {
-    std::vector<std::tuple<Actor, Components...>> result;
-    for (const auto& [entityID, actor] : registry.entities) {
-        if (hasAllComponents<Components...>(actor)) {
-            result.emplace_back(actor, *(actor.getComponent<Components>())...);
-        }
+    for (auto &pool: pools) {
+        if (!pool || !pool->contains(id))
+            continue;
+
+        if (pool->getOwner())
+            pool->getOwner()->onDestroy(id);
+
+        for (auto observer: pool->getObservers())
+            observer->onDestroy(id);
+
+        pool->remove(id);
     }
-    return result;
+
+    uint32_t index = actorIndex(id);
+    slots[index] = makeActorId(index, actorGeneration(id) + 1);
+    freeSlots.push_back(index);
 }
 
-template<typename... Components>
-template<typename Func>
-void Registry::View<Components...>::each(Func func) const {
-    for (const auto& [entityID, actor] : registry.entities) {
-        if (hasAllComponents<Components...>(actor)) {
-            func(*(actor.getComponent<Components>())...);
-        }
-    }
+CommandBuffer &Registry::getCommandBuffer() {
+    return *commandBuffers[JobSystem::getThreadIndex()];
+}
+
+void Registry::flushCommands() {
+    for (auto &buffer: commandBuffers)
+        buffer->playback(*this);
 }
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "Actor.hpp"
+#include "ComponentPool.hpp"
+#include "avalon/core/JobSystem.hpp"
+
+#include <stdexcept>
 
 // The `Registry` class manages the creation, destruction, and component management for entities in a game or simulation.
 // It allows entities to be composed of various components, and provides mechanisms for efficiently iterating over entities
@@ -32,87 +36,526 @@
 //     }
 // }
 // ```
+class CommandBuffer;
+
 class Registry {
 public:
+    Registry();
+
+    ~Registry();
+
+    Registry(const Registry &) = delete;
+
+    Registry &operator=(const Registry &) = delete;
+
     Actor createActor();
 
     void destroyActor(const Actor &entity);
 
+    /**
+     * O(1): the handle is valid if its generation still matches the one stored in its slot.
+     */
+    bool isValid(ActorId id) const {
+        uint32_t index = actorIndex(id);
+        return index < slots.size() && slots[index] == id;
+    }
+
+    /**
+     * Command buffer of the calling job system thread. Structural changes made from systems or while
+     * iterating a view must go through it; they are applied by flushCommands.
+     */
+    CommandBuffer &getCommandBuffer();
+
+    /**
+     * Plays back the command buffers of every thread. Must be called from a single thread while no
+     * system is running, SystemScheduler does so after each stage.
+     */
+    void flushCommands();
+
+    /**
+     * Number of actors currently alive.
+     */
+    std::size_t size() const {
+        return slots.size() - freeSlots.size();
+    }
+
+    /**
+     * Adds or replaces the actor's T component. Throws std::invalid_argument for a destroyed actor or a
+     * stale handle, whose slot may now belong to another actor.
+     */
+    template<typename T, typename... Args>
+    T &addComponent(ActorId id, Args &&... args) {
+        if (!isValid(id))
+            throw std::invalid_argument("addComponent on an invalid actor handle");
+
+        auto &pool = getPool<T>();
+        T &component = pool.emplace(id, std::forward<Args>(args)...);
+        pool.markChanged(id, currentTick);
+
+        if (pool.getOwner())
+            pool.getOwner()->onConstruct(id);
+
+        for (auto observer: pool.getObservers())
+            observer->onConstruct(id);
+
+        // the group or an observer may have moved the component, look it up again
+        return pool.getOwner() || !pool.getObservers().empty() ? *pool.get(id) : component;
+    }
+
+    template<typename T>
+    T *getComponent(ActorId id) {
+        auto pool = findPool<T>();
+        return pool ? pool->get(id) : nullptr;
+    }
+
+    template<typename T>
+    bool hasComponent(ActorId id) const {
+        auto pool = findPool<T>();
+        return pool && pool->contains(id);
+    }
+
+    template<typename T>
+    void removeComponent(ActorId id) {
+        auto pool = findPool<T>();
+        if (!pool || !pool->contains(id))
+            return;
+
+        if (pool->getOwner())
+            pool->getOwner()->onDestroy(id);
+
+        for (auto observer: pool->getObservers())
+            observer->onDestroy(id);
+
+        pool->remove(id);
+    }
+
+    /**
+     * Stamps the actor's T component with the current tick so Changed<T> views pick it up. Mutating a
+     * component through a pointer or a view does not do this by itself.
+     */
+    template<typename T>
+    void markChanged(ActorId id) {
+        auto pool = findPool<T>();
+        if (!pool || !pool->contains(id))
+            return;
+
+        pool->markChanged(id, currentTick);
+        for (auto observer: pool->getObservers())
+            observer->onUpdate(id);
+    }
+
+    /**
+     * Calls func(T &) on the actor's T component, if any, and marks it as changed.
+     */
+    template<typename T, typename Func>
+    void patch(ActorId id, Func func) {
+        auto pool = findPool<T>();
+        if (!pool || !pool->contains(id))
+            return;
+
+        func(*pool->get(id));
+        pool->markChanged(id, currentTick);
+
+        for (auto observer: pool->getObservers())
+            observer->onUpdate(id);
+    }
+
+    /**
+     * Registers an observer of every change made to T components through the registry. The observer
+     * must be removed with unobserve before it is destroyed.
+     */
+    template<typename T>
+    void observe(ComponentObserver &observer) {
+        getPool<T>().addObserver(&observer);
+    }
+
+    template<typename T>
+    void unobserve(ComponentObserver &observer) {
+        if (auto pool = findPool<T>())
+            pool->removeObserver(&observer);
+    }
+
+    /**
+     * Starts a new change detection tick, typically once per frame.
+     */
+    void advanceTick() {
+        ++currentTick;
+    }
+
+    uint32_t getTick() const {
+        return currentTick;
+    }
+
+    /**
+     * Returns the pool storing every component of type T, creating it on first use.
+     */
+    template<typename T>
+    ComponentPool<T> &getPool() {
+        uint32_t type = ComponentType::id<T>();
+        if (type >= pools.size())
+            pools.resize(type + 1);
+
+        if (!pools[type])
+            pools[type] = CreateScope<ComponentPool<T>>();
+
+        return static_cast<ComponentPool<T> &>(*pools[type]);
+    }
+
+    /**
+     * Returns the pool storing every component of type T, or nullptr if none was ever added.
+     */
+    template<typename T>
+    ComponentPool<T> *findPool() const {
+        uint32_t type = ComponentType::id<T>();
+        return type < pools.size() ? static_cast<ComponentPool<T> *>(pools[type].get()) : nullptr;
+    }
+
+    /**
+     * Non-owning view over every actor having all of the given components. Iteration walks the packed
+     * actor array of the smallest pool and probes the other pools, nothing is copied or allocated.
+     * Components are handed out by reference; a `const` component type yields a const reference.
+     */
     template<typename... Components>
     class View {
+        template<typename T>
+        using Pool = ComponentPool<std::remove_const_t<ComponentOf<T>>>;
+
     public:
-        View(Registry &registry) : registry(registry) {}
+        View(Registry &registry, uint32_t since) : registry(registry), pools(registry.findPool<std::remove_const_t<ComponentOf<Components>>>()...), since(since) {
+            bool complete = ((std::get<Pool<Components> *>(pools) != nullptr) && ...);
+            if (!complete)
+                return;
 
-        // Callback-based iteration
+            // drive the iteration from the smallest pool, every other pool is only probed
+            ((candidates = (candidates == nullptr || std::get<Pool<Components> *>(pools)->size() < candidates->size())
+                    ? &std::get<Pool<Components> *>(pools)->getActors() : candidates), ...);
+        }
+
+        template<bool WithComponents>
+        class BasicIterator {
+        public:
+            BasicIterator(const View *view, std::size_t index) : view(view), index(index) {
+                skip();
+            }
+
+            bool operator!=(const BasicIterator &other) const { return index != other.index; }
+
+            bool operator==(const BasicIterator &other) const { return index == other.index; }
+
+            BasicIterator &operator++() {
+                ++index;
+                skip();
+                return *this;
+            }
+
+            auto operator*() const {
+                ActorId id = (*view->candidates)[index];
+                if constexpr (WithComponents)
+                    return view->get(id);
+                else
+                    return Actor(id, &view->registry);
+            }
+
+        private:
+            void skip() {
+                while (index < view->candidateCount() && !view->contains((*view->candidates)[index]))
+                    ++index;
+            }
+
+            const View *view;
+            std::size_t index;
+        };
+
+        // yields Actor
+        using Iterator = BasicIterator<false>;
+
+        // yields std::tuple<Actor, Components &...>
+        using EachIterator = BasicIterator<true>;
+
+        // holds a copy of the view so `registry.view<...>().each()` can be iterated directly
+        class EachRange {
+        public:
+            explicit EachRange(const View &view) : view(view) {}
+
+            EachIterator begin() const { return EachIterator(&view, 0); }
+
+            EachIterator end() const { return EachIterator(&view, view.candidateCount()); }
+
+        private:
+            View view;
+        };
+
+        // Callback-based iteration, func takes either (Components &...) or (Actor, Components &...)
         template<typename Func>
-        void each(Func func) const;
+        void each(Func func) const {
+            for (std::size_t i = 0, count = candidateCount(); i < count; i++) {
+                ActorId id = (*candidates)[i];
+                if (!contains(id))
+                    continue;
+
+                if constexpr (std::is_invocable_v<Func, Actor, ComponentOf<Components> &...>)
+                    func(Actor(id, &registry), component<Components>(id)...);
+                else
+                    func(component<Components>(id)...);
+            }
+        }
 
         // Range-based for loop
-        auto each() const;
+        EachRange each() const {
+            return EachRange(*this);
+        }
+
+        /**
+         * Like each(func), but the view is split in chunks of grainSize candidates processed on the job
+         * system. func is called concurrently and must not add or remove components or actors.
+         */
+        template<typename Func>
+        void parallelEach(Func func, std::size_t grainSize = 1024) const {
+            JobSystem::getInstance().parallelFor(candidateCount(), grainSize, [this, &func](std::size_t begin, std::size_t end) {
+                for (std::size_t i = begin; i < end; i++) {
+                    ActorId id = (*candidates)[i];
+                    if (!contains(id))
+                        continue;
+
+                    if constexpr (std::is_invocable_v<Func, Actor, ComponentOf<Components> &...>)
+                        func(Actor(id, &registry), component<Components>(id)...);
+                    else
+                        func(component<Components>(id)...);
+                }
+            });
+        }
 
         // Forward iterators
+        Iterator begin() const {
+            return Iterator(this, 0);
+        }
+
+        Iterator end() const {
+            return Iterator(this, candidateCount());
+        }
+
+        template<typename T>
+        T &get(Actor entity) const {
+            return component<T>(entity.getId());
+        }
+
+        /**
+         * Upper bound of the number of actors in the view: the size of the smallest pool.
+         */
+        std::size_t sizeHint() const {
+            return candidateCount();
+        }
+
+    private:
+        std::tuple<Actor, ComponentOf<Components> &...> get(ActorId id) const {
+            return std::tuple<Actor, ComponentOf<Components> &...>(Actor(id, &registry), component<Components>(id)...);
+        }
+
+        template<typename T>
+        ComponentOf<T> &component(ActorId id) const {
+            auto pool = std::get<Pool<T> *>(pools);
+            return pool->getComponents()[pool->indexOf(id)];
+        }
+
+        /*
+         * Checks if the actor has all the components specified, changed after `since` for Changed<T>
+         */
+        bool contains(ActorId id) const {
+            return (matches<Components>(id) && ...);
+        }
+
+        template<typename T>
+        bool matches(ActorId id) const {
+            auto pool = std::get<Pool<T> *>(pools);
+            if (!pool->contains(id))
+                return false;
+
+            if constexpr (ComponentTraits<T>::changedOnly)
+                return pool->getChangedTick(pool->indexOf(id)) > since;
+            else
+                return true;
+        }
+
+        std::size_t candidateCount() const {
+            return candidates ? candidates->size() : 0;
+        }
+
+        Registry &registry;
+        std::tuple<Pool<Components> *...> pools;
+        const std::vector<ActorId> *candidates = nullptr;
+        uint32_t since;
+    };
+
+    /**
+     * Owning group: keeps every actor having all of the Owned components packed at the front of each
+     * owned pool, in the same order. Iterating a group is a linear scan over [0, size()) of every pool
+     * with no membership test. A component type can be owned by a single group.
+     *
+     * A group built over an `owner` with the same types in another order does not own the pools, it
+     * reads the packed range the owner maintains.
+     */
+    template<typename... Owned>
+    class Group : public GroupBase {
+    public:
+        explicit Group(Registry &registry, GroupBase *owner = nullptr)
+                : GroupBase({ComponentType::id<Owned>()...}), registry(registry), pools(&registry.getPool<Owned>()...),
+                  owner(owner ? owner : this) {
+            if (owner)
+                return;
+
+            (std::get<ComponentPool<Owned> *>(pools)->setOwner(this), ...);
+
+            // pull in the actors that already own every component
+            auto &lead = *std::get<0>(pools);
+            for (uint32_t i = 0; i < lead.size(); i++)
+                onConstruct(lead.getActors()[i]);
+        }
+
+        ~Group() override {
+            if (owner == this)
+                (std::get<ComponentPool<Owned> *>(pools)->setOwner(nullptr), ...);
+        }
+
+        void onConstruct(ActorId id) override {
+            if (!(std::get<ComponentPool<Owned> *>(pools)->contains(id) && ...) || grouped(id))
+                return;
+
+            (std::get<ComponentPool<Owned> *>(pools)->swapEntries(std::get<ComponentPool<Owned> *>(pools)->indexOf(id), length), ...);
+            ++length;
+        }
+
+        void onDestroy(ActorId id) override {
+            if (!(std::get<ComponentPool<Owned> *>(pools)->contains(id) && ...) || !grouped(id))
+                return;
+
+            --length;
+            (std::get<ComponentPool<Owned> *>(pools)->swapEntries(std::get<ComponentPool<Owned> *>(pools)->indexOf(id), length), ...);
+        }
+
         class Iterator {
         public:
-            Iterator(typename std::vector<std::tuple<Actor, Components...>>::const_iterator it) : it(it) {}
+            Iterator(const Group *group, uint32_t index) : group(group), index(index) {}
 
-            bool operator!=(const Iterator &other) const { return it != other.it; }
+            bool operator!=(const Iterator &other) const { return index != other.index; }
 
             Iterator &operator++() {
-                ++it;
+                ++index;
                 return *this;
             }
 
-            std::tuple<Actor, Components...> operator*() const { return *it; }
+            std::tuple<Actor, Owned &...> operator*() const {
+                return group->get(index);
+            }
 
         private:
-            typename std::vector<std::tuple<Actor, Components...>>::const_iterator it;
+            const Group *group;
+            uint32_t index;
         };
 
         Iterator begin() const {
-            return Iterator(data.begin());
+            return Iterator(this, 0);
         }
 
         Iterator end() const {
-            return Iterator(data.end());
+            return Iterator(this, owner->size());
         }
 
-        template<typename T>
-        T &get(Actor entity) const {
-            auto component = entity.getComponent<T>();
-            if (component) {
-                return *component;
+        // Callback-based iteration, func takes either (Owned &...) or (Actor, Owned &...)
+        template<typename Func>
+        void each(Func func) const {
+            auto components = std::make_tuple(std::get<ComponentPool<Owned> *>(pools)->getComponents().data()...);
+            const ActorId *actors = std::get<0>(pools)->getActors().data();
+
+            for (uint32_t i = 0; i < owner->size(); i++) {
+                if constexpr (std::is_invocable_v<Func, Actor, Owned &...>)
+                    func(Actor(actors[i], &registry), std::get<Owned *>(components)[i]...);
+                else
+                    func(std::get<Owned *>(components)[i]...);
             }
-            return nullptr;
         }
 
-    private:
-        // Base case: No more components to check
-        template<typename Actor, typename Component>
-        bool hasComponent(const Actor &actor) {
-            return actor.getComponent<Component>() != nullptr;
+        /**
+         * Like each(func), but the group is split in chunks of grainSize actors processed on the job
+         * system. func is called concurrently and must not add or remove components or actors.
+         */
+        template<typename Func>
+        void parallelEach(Func func, std::size_t grainSize = 1024) const {
+            JobSystem::getInstance().parallelFor(owner->size(), grainSize, [this, &func](std::size_t begin, std::size_t end) {
+                auto components = std::make_tuple(std::get<ComponentPool<Owned> *>(pools)->getComponents().data()...);
+                const ActorId *actors = std::get<0>(pools)->getActors().data();
+
+                for (std::size_t i = begin; i < end; i++) {
+                    if constexpr (std::is_invocable_v<Func, Actor, Owned &...>)
+                        func(Actor(actors[i], &registry), std::get<Owned *>(components)[i]...);
+                    else
+                        func(std::get<Owned *>(components)[i]...);
+                }
+            });
         }
 
-        /*
-         * Checks recursively if the actor has the components specified
-         */
-        template<typename Actor, typename Component, typename... Components>
-        bool hasAllComponents(const Actor &actor) {
-            return hasComponent<Actor, Component>(actor) && hasAllComponents<Actor, Components...>(actor);
+        std::size_t size() const {
+            return owner->size();
         }
 
-        // End of recursion
-        template<typename Actor>
-        bool hasAllComponents(const Actor &actor) {
-            return true;
+    private:
+        bool grouped(ActorId id) const {
+            return std::get<0>(pools)->indexOf(id) < length;
+        }
+
+        std::tuple<Actor, Owned &...> get(uint32_t index) const {
+            return std::tuple<Actor, Owned &...>(Actor(std::get<0>(pools)->getActors()[index], &registry),
+                                                 std::get<ComponentPool<Owned> *>(pools)->getComponents()[index]...);
         }
 
         Registry &registry;
-        mutable std::vector<std::tuple<Actor, Components...>> data;  // To store entities and their components
+        std::tuple<ComponentPool<Owned> *...> pools;
+        GroupBase *owner; // this, or the group owning the pools
     };
 
+    /**
+     * Returns the group owning the given component types, creating it on first use. The order of the
+     * types does not matter. Throws std::logic_error if one of the types is already owned by a group
+     * over a different set of types.
+     */
+    template<typename... Owned>
+    Group<Owned...> &group() {
+        static_assert(sizeof...(Owned) > 1, "A group needs at least two component types");
+
+        GroupBase *owner = nullptr;
+        ((owner = owner ? owner : getPool<Owned>().getOwner()), ...);
+
+        if (owner) {
+            std::vector<uint32_t> types{ComponentType::id<Owned>()...};
+            std::sort(types.begin(), types.end());
+            if (types != owner->getTypes())
+                throw std::logic_error("Component type is already owned by another group");
+
+            // the owner itself, or a group over the same types in another order
+            for (auto &existing: groups) {
+                if (auto group = dynamic_cast<Group<Owned...> *>(existing.get()))
+                    return *group;
+            }
+
+            groups.push_back(CreateScope<Group<Owned...>>(*this, owner));
+            return static_cast<Group<Owned...> &>(*groups.back());
+        }
+
+        groups.push_back(CreateScope<Group<Owned...>>(*this));
+        return static_cast<Group<Owned...> &>(*groups.back());
+    }
+
+    /**
+     * View over the actors having all of the given components. Changed<T> filters are evaluated against
+     * `since`, the default keeps the changes stamped during the current tick.
+     */
+    template<typename... Components>
+    View<Components...> view(uint32_t since) {
+        return View<Components...>(*this, since);
+    }
+
     template<typename... Components>
     View<Components...> view() {
-        return View<Components...>(*this);
+        return View<Components...>(*this, currentTick - 1);
     }
 
     friend void to_json(json &j, const Registry &registry);
@@ -120,6 +563,44 @@ public:
     friend void from_json(const json *j, Registry &registry);
 
 private:
-    std::unordered_map<ActorId, Actor> entities;
-    ActorId nextEntityID = 0;
+    // slot i holds the id of the actor living at index i; once destroyed it holds the id the slot
+    // will be reissued with, i.e. the same index with the next generation
+    std::vector<ActorId> slots;
+    std::vector<uint32_t> freeSlots;
+
+    // change detection clock, components are stamped with it when added or marked as changed
+    uint32_t currentTick = 1;
+
+    // one pool per component type, indexed by ComponentType::id
+    std::vector<Scope<ComponentPoolBase>> pools;
+    std::vector<Scope<GroupBase>> groups;
+
+    // one per job system thread, indexed by JobSystem::getThreadIndex
+    std::vector<Scope<CommandBuffer>> commandBuffers;
 };
+
+// Actor is only a handle, its component accessors forward to the parent registry.
+
+inline bool Actor::isValid() const {
+    return parentRegistry != nullptr && parentRegistry->isValid(id);
+}
+
+template<typename T, typename... Args>
+T &Actor::addComponent(Args &&... args) {
+    return parentRegistry->addComponent<T>(id, std::forward<Args>(args)...);
+}
+
+template<typename T>
+T *Actor::getComponent() const {
+    return parentRegistry->getComponent<T>(id);
+}
+
+template<typename T>
+bool Actor::hasComponent() const {
+    return parentRegistry->hasComponent<T>(id);
+}
+
+template<typename T>
+void Actor::removeComponent() {
+    parentRegistry->removeComponent<T>(id);
+}
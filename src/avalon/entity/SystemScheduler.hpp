@@ -0,0 +1,114 @@
+#pragma once
+
+#include "CommandBuffer.hpp"
+
+// Tags declaring the component types a system reads and writes, see SystemScheduler::addSystem.
+
+template<typename... Components>
+struct Read {
+};
+
+template<typename... Components>
+struct Write {
+};
+
+/**
+ * Runs systems declared with the component types they read and write. Systems are split in stages:
+ * a system lands in the first stage after every earlier system it conflicts with (one writes a type
+ * the other reads or writes), so declaration order is kept between conflicting systems while the
+ * systems of a stage run concurrently on the job system. Structural changes recorded in the registry's
+ * command buffers are flushed after every stage.
+ *
+ * Example:
+ *
+ * scheduler.addSystem("movement", Read<Velocity>{}, Write<Position>{}, [](Registry &registry, float dt) {
+ *     registry.view<const Velocity, Position>().parallelEach([dt](const Velocity &vel, Position &pos) {
+ *         pos.x += vel.dx * dt;
+ *     });
+ * });
+ */
+class SystemScheduler {
+public:
+    using System = std::function<void(Registry &, float)>;
+
+    template<typename... Reads, typename... Writes, typename Func>
+    void addSystem(const std::string &name, Read<Reads...>, Write<Writes...>, Func func) {
+        systems.push_back({
+                name,
+                {ComponentType::id<std::remove_const_t<Reads>>()...},
+                {ComponentType::id<std::remove_const_t<Writes>>()...},
+                System(std::move(func))
+        });
+        stagesDirty = true;
+    }
+
+    void run(Registry &registry, float deltaTime) {
+        if (stagesDirty)
+            buildStages();
+
+        JobSystem &jobs = JobSystem::getInstance();
+
+        for (auto &stage: stages) {
+            if (stage.size() == 1) {
+                systems[stage[0]].system(registry, deltaTime);
+            } else {
+                JobSystem::Counter counter;
+                for (auto index: stage)
+                    jobs.submit([this, &registry, deltaTime, index]() { systems[index].system(registry, deltaTime); }, counter);
+                jobs.wait(counter);
+            }
+
+            registry.flushCommands();
+        }
+    }
+
+    std::size_t getStageCount() {
+        if (stagesDirty)
+            buildStages();
+        return stages.size();
+    }
+
+private:
+    struct Entry {
+        std::string name;
+        std::vector<uint32_t> reads;
+        std::vector<uint32_t> writes;
+        System system;
+    };
+
+    static bool writesAny(const Entry &writer, const std::vector<uint32_t> &types) {
+        for (auto type: writer.writes) {
+            if (std::find(types.begin(), types.end(), type) != types.end())
+                return true;
+        }
+        return false;
+    }
+
+    static bool conflicts(const Entry &a, const Entry &b) {
+        return writesAny(a, b.reads) || writesAny(a, b.writes) || writesAny(b, a.reads);
+    }
+
+    void buildStages() {
+        stages.clear();
+        std::vector<std::size_t> stageOf(systems.size());
+
+        for (std::size_t i = 0; i < systems.size(); i++) {
+            std::size_t stage = 0;
+            for (std::size_t j = 0; j < i; j++) {
+                if (conflicts(systems[i], systems[j]))
+                    stage = std::max(stage, stageOf[j] + 1);
+            }
+
+            stageOf[i] = stage;
+            if (stage >= stages.size())
+                stages.resize(stage + 1);
+            stages[stage].push_back(i);
+        }
+
+        stagesDirty = false;
+    }
+
+    std::vector<Entry> systems;
+    std::vector<std::vector<std::size_t>> stages;
+    bool stagesDirty = false;
+};
@@ -0,0 +1,281 @@
+#pragma once
+
+#include "Texture.hpp"
+#include "Shader.hpp"
+#include "Camera.hpp"
+#include "Font.hpp"
+#include "Color.hpp"
+#include "GLExtensions.hpp"
+#include "GLState.hpp"
+#include "avalon/utils/PlatformUtils.hpp"
+
+#include <span>
+
+/**
+ * Consecutive shapes of the sorted render queue sharing a shader and up to getTextureCapacity()
+ * textures, drawn with a single call. Batches are
+ * pooled by the Renderer and reused across frames: the GL objects are created once, and the batch's
+ * records (vertices or instances, see RenderBatch and InstanceBatch) are streamed through a ring of
+ * FramesInFlight regions so the CPU never writes a region the GPU may still read. When persistent
+ * mapping is available the ring stays mapped and every region is guarded by a fence; otherwise the
+ * region is updated with glBufferSubData.
+ */
+class Batch {
+public:
+    static constexpr uint32_t FramesInFlight = 3;
+
+    // slots addressable in bindless mode, limited by the 8 bit slot of vertices and instances
+    static constexpr uint32_t BindlessTextureSlots = 128;
+
+    Batch(int32_t maxBatchSize, Ref<Shader> shader) : maxBatchSize(maxBatchSize), shader(std::move(shader)) {
+        lookupUniforms();
+    }
+
+    virtual ~Batch() {
+        for (auto &fence: fences)
+            if (fence) glDeleteSync(fence);
+
+        GLState::onDeleteVertexArray(VAO);
+        GLState::onDeleteBuffer(VBO);
+
+        if (VAO) glDeleteVertexArrays(1, &VAO);
+        if (VBO) glDeleteBuffers(1, &VBO);
+    }
+
+    // owns GL objects
+    Batch(const Batch &) = delete;
+
+    Batch &operator=(const Batch &) = delete;
+
+    virtual void addShape(const glm::vec3 &position, const glm::vec2 &scale, float rotation, uint32_t shape, const glm::vec4 &color, const Ref<Texture> &texture, const std::array<glm::vec2, 4> &texCoords) = 0;
+
+    /**
+     * Empties the batch so it can be filled again next frame, keeping its GL objects.
+     */
+    void clear() {
+        idleFrames = isEmpty() ? idleFrames + 1 : 0;
+
+        clearRecords();
+        textures.clear();
+        textureSlots.clear();
+        quadCount = 0;
+    }
+
+    /**
+     * Draws the batch. Camera and time come from the Frame uniform block and the sampler slots are set
+     * at link time, so only the textures of the batch are bound here.
+     */
+    void render() {
+
+        //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        shader->bind();
+
+        if (bindlessTextures) {
+            // slot 0 means no texture, handles start at uTextures[1]
+            handles.clear();
+            for (auto &texture: textures)
+                handles.push_back(texture->getHandle());
+
+            if (!handles.empty())
+                textureHandles.set(handles.data(), static_cast<int>(handles.size()));
+        } else {
+            for (uint32_t i = 0; i < textures.size(); i++)
+                textures[i]->bind(i + 1);
+        }
+
+        GLState::bindVertexArray(VAO);
+
+        // move on to the next region of the ring, waiting for the GPU if it still reads it
+        region = (region + 1) % FramesInFlight;
+        waitForRegion();
+
+        std::span<const std::byte> data = getRecords();
+        std::size_t offset = region * regionSize();
+
+        if (mapped) {
+            std::memcpy(mapped + offset, data.data(), data.size());
+        } else {
+            GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
+            glBufferSubData(GL_ARRAY_BUFFER, offset, data.size(), data.data());
+        }
+
+        draw(region * recordsPerRegion);
+
+        if (mapped)
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        // textures and the VAO stay bound, the next batch only rebinds what differs
+    }
+
+    bool hasTextureRoom() const {
+        return textures.size() < getTextureCapacity();
+    }
+
+    /**
+     * Sets the number of texture slots of the shaders (MAX_TEXTURE_SLOTS), slot 0 being reserved for
+     * untextured shapes. Called once by Renderer::init before any batch exists.
+     */
+    static void setTextureSlots(uint32_t slots, bool bindless) {
+        bindlessTextures = bindless;
+        textureSlotCount = slots;
+    }
+
+    // textures a batch can hold
+    static uint32_t getTextureCapacity() {
+        return textureSlotCount - 1;
+    }
+
+    bool hasTexture(const Ref<Texture> &texture) const {
+        return textureSlots.contains(texture.get());
+    }
+
+    /**
+     * Whether a shape with the given texture (or none) can be added without exceeding the texture slots.
+     */
+    bool canHold(const Ref<Texture> &texture) const {
+        return texture == nullptr || hasTextureRoom() || hasTexture(texture);
+    }
+
+    bool isFull() const {
+        return quadCount >= maxBatchSize;
+    }
+
+    bool isEmpty() const {
+        return quadCount == 0;
+    }
+
+    const Ref<Shader> &getShader() const {
+        return shader;
+    }
+
+    /**
+     * Changes the shader of an empty batch, used when the Renderer reuses it. The shader must accept
+     * the batch's vertex layout.
+     */
+    void setShader(const Ref<Shader> &batchShader) {
+        if (shader == batchShader)
+            return;
+
+        shader = batchShader;
+        lookupUniforms();
+    }
+
+    /**
+     * Number of consecutive frames the batch was cleared without holding any quad.
+     */
+    uint32_t getIdleFrames() const {
+        return idleFrames;
+    }
+
+protected:
+
+    /**
+     * Creates the VAO and the ring buffer, leaving both bound so the subclass can describe its
+     * attributes. Subclasses call it from their constructor.
+     */
+    void createBuffers(std::size_t stride, uint32_t records) {
+        recordStride = stride;
+        recordsPerRegion = records;
+
+        // Create and bind the Vertex Array Object (VAO)
+        glGenVertexArrays(1, &VAO);
+        GLState::bindVertexArray(VAO);
+
+        // Generate the Vertex Buffer Object (VBO), one region per frame in flight
+        glGenBuffers(1, &VBO);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
+
+        std::size_t bytes = FramesInFlight * regionSize();
+
+        if (GLExtensions::hasBufferStorage) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+            GLExtensions::bufferStorage(GL_ARRAY_BUFFER, bytes, nullptr, flags);
+            mapped = static_cast<uint8_t *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags));
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_DYNAMIC_DRAW);
+        }
+    }
+
+    /**
+     * Slot the texture is bound to while rendering, 0 when there is no texture.
+     */
+    uint32_t acquireTextureSlot(const Ref<Texture> &texture) {
+        if (texture == nullptr)
+            return 0;
+
+        auto [it, inserted] = textureSlots.try_emplace(texture.get(), static_cast<uint32_t>(textures.size() + 1));
+        if (inserted)
+            textures.push_back(texture);
+
+        return it->second;
+    }
+
+    // records written this frame, uploaded to the current region
+    virtual std::span<const std::byte> getRecords() const = 0;
+
+    virtual void clearRecords() = 0;
+
+    // issues the draw call, the region starts at record `first` of the ring
+    virtual void draw(uint32_t first) = 0;
+
+    static uint32_t packColor(const glm::vec4 &color) {
+        auto channel = [](float value) {
+            return static_cast<uint32_t>(glm::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+        };
+        return channel(color.x) | channel(color.y) << 8 | channel(color.z) << 16 | channel(color.w) << 24;
+    }
+
+    static uint16_t packUnorm16(float value) {
+        return static_cast<uint16_t>(glm::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+    }
+
+    uint32_t maxBatchSize = 0;
+    uint32_t quadCount = 0;
+
+    GLuint VAO{}, VBO{};
+
+    Ref<Shader> shader;
+
+    UniformHandle textureHandles; // bindless handles from uTextures[1], looked up once per shader
+
+    std::vector<Ref<Texture>> textures;
+    std::unordered_map<const Texture *, uint32_t> textureSlots; // texture -> slot, in sync with `textures`
+
+private:
+
+    void lookupUniforms() {
+        textureHandles = shader ? shader->getUniform("uTextures[1]") : UniformHandle();
+    }
+
+    void waitForRegion() {
+        GLsync &fence = fences[region];
+        if (!fence)
+            return;
+
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED && result != GL_WAIT_FAILED)
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    std::size_t regionSize() const {
+        return recordsPerRegion * recordStride;
+    }
+
+    uint32_t idleFrames = 0;
+
+    // ring of FramesInFlight regions in VBO, mapped for the lifetime of the batch when persistent
+    std::size_t recordStride = 0;
+    uint32_t recordsPerRegion = 0;
+    uint32_t region = 0;
+    uint8_t *mapped = nullptr;
+    GLsync fences[FramesInFlight] = {};
+
+    std::vector<GLuint64> handles;
+
+    inline static bool bindlessTextures = false;
+    inline static uint32_t textureSlotCount = 9; // MAX_TEXTURE_SLOTS of the shaders, replaced by setTextureSlots
+};
@@ -5,6 +5,8 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glad/glad.h>
 
+#include "GLState.hpp"
+
 class Camera {
 public:
     Camera() = default;
@@ -27,7 +29,7 @@ public:
         int xOffset = (windowWidth - static_cast<int>(viewportWidth)) / 2;
         int yOffset = (windowHeight - static_cast<int>(viewportHeight)) / 2;
 
-        glViewport(xOffset, yOffset, static_cast<GLsizei>(viewportWidth), static_cast<GLsizei>(viewportHeight));
+        GLState::setViewport(xOffset, yOffset, static_cast<GLsizei>(viewportWidth), static_cast<GLsizei>(viewportHeight));
 
         float halfWidth = viewportWidth / this->zoomFactor * 0.5f;
         float halfHeight = viewportHeight / this->zoomFactor * 0.5f;
@@ -40,6 +42,27 @@ public:
         this->projectionMatrix = glm::ortho(left, right, bottom, top, 0.0f, 100.0f);
 
        this->windowSize = glm::vec2(windowWidth, windowHeight);
+
+        // world rectangle covered by the viewport, taken from the full view-projection so it matches what is drawn
+        glm::mat4 inverseVP = glm::inverse(projectionMatrix * getViewMatrix());
+        glm::vec2 a = glm::vec2(inverseVP * glm::vec4(-1.0f, -1.0f, 0.0f, 1.0f));
+        glm::vec2 b = glm::vec2(inverseVP * glm::vec4(1.0f, 1.0f, 0.0f, 1.0f));
+        visibleMin = glm::min(a, b);
+        visibleMax = glm::max(a, b);
+    }
+
+    /**
+     * Lower-left corner of the visible world rectangle, updated by applyViewport.
+     */
+    glm::vec2 getVisibleMin() const {
+        return visibleMin;
+    }
+
+    /**
+     * Upper-right corner of the visible world rectangle, updated by applyViewport.
+     */
+    glm::vec2 getVisibleMax() const {
+        return visibleMax;
     }
 
     glm::mat4 getViewMatrix() {
@@ -104,5 +127,6 @@ private:
     glm::mat4 projectionMatrix, viewMatrix;
     glm::vec2 worldPosition;
     glm::vec2 windowSize;  // Store window size for screen to world conversion
+    glm::vec2 visibleMin{0.0f}, visibleMax{0.0f};
     float zoomFactor;
 };
@@ -1,43 +1,174 @@
 #pragma once
 
 #include "avalon/core/Core.hpp"
+#include "Texture.hpp"
+#include "Shape.hpp"
 
 #include <freetype/freetype.h>
+#include <freetype/ftmodapi.h>
+
+#include <list>
+#include <string_view>
 
 // https://learnopengl.com/In-Practice/Text-Rendering
 
+/**
+ * Bitmap glyphs are plain coverage and look right near their pixel size. SDF glyphs store the distance
+ * to the outline and stay sharp at any size, so one atlas serves every text size.
+ */
+enum class FontMode {
+    Bitmap,
+    SDF
+};
+
 struct Character {
 
-    uint32_t textureID; // ID handle of the glyph texture
+    std::array<glm::vec2, 4> texCoords; // Region of the glyph in the font atlas, same corner order as Sprite
     glm::ivec2 size; // Size of glyph
     glm::vec2 bearing; // Offset from baseline to left/top of glyph
-    uint32_t advance; // Horizontal offset to advance to next glyph
+    uint32_t advance; // Horizontal offset to advance to next glyph, in 1/64 pixels
 };
 
+/**
+ * Font rasterizing glyphs on first use into a single atlas texture of uniform cells, so a whole text is
+ * drawn from one texture slot and only the characters actually drawn are rendered. When the atlas is
+ * full the least recently used glyph gives its cell away; glyphs used in the current frame are never
+ * evicted since quads waiting for the flush still point to them.
+ *
+ * Glyphs are stored white with their coverage (or distance, in SDF mode) in alpha, the text color
+ * comes from the shape color.
+ */
 class Font {
 public:
+    static constexpr uint32_t DefaultPixelSize = 32;
+    static constexpr int AtlasSize = 1024;
+    static constexpr int SdfSpread = 8; // distance range of SDF glyphs on each side of the outline, in pixels
+
     Font() = default;
 
-    Font(std::string &filePath) : filePath(filePath) {
+    explicit Font(const std::string &filePath, FontMode mode = FontMode::SDF, uint32_t pixelSize = DefaultPixelSize)
+            : filePath(filePath), mode(mode), pixelSize(pixelSize) {
         load();
     }
 
     ~Font() {
+        if (face)
+            FT_Done_Face(face);
+    }
+
+    Font(const Font &) = delete;
+
+    Font &operator=(const Font &) = delete;
+
+    /**
+     * Glyph of a Unicode code point, rasterized on first use. Fonts draw their missing glyph for code
+     * points they do not cover; nullptr only if the glyph cannot be rendered, which is remembered, or
+     * the atlas is full of glyphs used this frame, which is retried on the next frame.
+     */
+    const Character *getCharacter(uint32_t codepoint) {
+        auto it = glyphs.find(codepoint);
+        if (it != glyphs.end()) {
+            Glyph &glyph = it->second;
+            glyph.lastUsed = frame;
+            if (glyph.cell != NoCell)
+                lru.splice(lru.begin(), lru, glyph.position);
+            return &glyph.character;
+        }
+
+        if (failed.contains(codepoint) || fullFrame == frame)
+            return nullptr;
+
+        return rasterize(codepoint);
+    }
+
+    const Ref<Texture> &getTexture() const {
+        return texture;
+    }
+
+    /**
+     * Shape the glyphs of this font are drawn with, the shaders read SDF glyphs differently.
+     */
+    Shape getShape() const {
+        return mode == FontMode::SDF ? Shape::SDF_TEXT : Shape::TEXT;
+    }
 
-        for (auto &character: characters)
-            if (character.second.textureID)
-                glDeleteTextures(1, &character.second.textureID);
+    uint32_t getPixelSize() const {
+        return pixelSize;
     }
 
-    const Character &getCharacter(char c) const {
-        return characters.at(c);
+    /**
+     * Distance between two baselines, in pixels.
+     */
+    float getLineHeight() const {
+        return lineHeight;
     }
 
     bool operator==(const Font& other) const {
         return filePath == other.filePath;
     }
 
+    /**
+     * Starts a new frame for every font, glyphs of the previous frame become evictable. Called by the
+     * renderer once the frame is flushed.
+     */
+    static void nextFrame() {
+        frame++;
+    }
+
+    /**
+     * Decodes the code point starting at `offset` and moves past it. Malformed sequences decode to
+     * U+FFFD one byte at a time.
+     */
+    static uint32_t decodeUtf8(std::string_view text, std::size_t &offset) {
+        constexpr uint32_t Replacement = 0xFFFD;
+        auto byte = static_cast<uint8_t>(text[offset++]);
+
+        if (byte < 0x80)
+            return byte;
+
+        int length;
+        uint32_t codepoint;
+        if ((byte & 0xE0) == 0xC0) {
+            length = 1;
+            codepoint = byte & 0x1F;
+        } else if ((byte & 0xF0) == 0xE0) {
+            length = 2;
+            codepoint = byte & 0x0F;
+        } else if ((byte & 0xF8) == 0xF0) {
+            length = 3;
+            codepoint = byte & 0x07;
+        } else {
+            return Replacement;
+        }
+
+        if (offset + length > text.size())
+            return Replacement;
+
+        for (int i = 0; i < length; i++) {
+            auto continuation = static_cast<uint8_t>(text[offset + i]);
+            if ((continuation & 0xC0) != 0x80)
+                return Replacement;
+            codepoint = codepoint << 6 | (continuation & 0x3F);
+        }
+
+        // overlong forms, surrogates and values past Unicode
+        constexpr uint32_t minimum[] = {0, 0x80, 0x800, 0x10000};
+        if (codepoint < minimum[length] || (codepoint >= 0xD800 && codepoint <= 0xDFFF) || codepoint > 0x10FFFF)
+            return Replacement;
+
+        offset += length;
+        return codepoint;
+    }
+
 private:
+    static constexpr uint32_t NoCell = UINT32_MAX;
+
+    struct Glyph {
+        Character character;
+        uint32_t cell = NoCell; // none for glyphs without pixels, e.g. spaces
+        uint64_t lastUsed = 0;
+        std::list<uint32_t>::iterator position; // in lru
+    };
 
     void load() {
 
@@ -46,49 +177,108 @@ private:
             isLoaded = true;
         }
 
-        FT_Face face;
         if (FT_New_Face(ft, filePath.c_str(), 0, &face)) {
-            AV_CORE_WARN("ERROR::FREETYPE: Failed to loadLibs font");
+            AV_CORE_WARN("ERROR::FREETYPE: Failed to load font {0}", filePath);
+            face = nullptr;
+            return;
         }
 
-        for (unsigned char c = 0; c < 128; c++) {
-            if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
-                AV_CORE_WARN("ERROR::FREETYPE: Failed to loadLibs Glyph for character: {0}", c);
-                continue;
-            }
+        FT_Set_Pixel_Sizes(face, 0, pixelSize);
+        lineHeight = static_cast<float>(face->size->metrics.height) / 64.0f;
+
+        // room for the tallest glyphs, the SDF spread and one empty pixel keeping filtering inside the cell
+        int padding = mode == FontMode::SDF ? SdfSpread : 0;
+        cellSize = static_cast<int>(pixelSize + pixelSize / 2) + 2 * padding + 1;
+        cellsPerRow = AtlasSize / cellSize;
+
+        std::vector<uint8_t> empty(static_cast<std::size_t>(AtlasSize) * AtlasSize * 4, 0);
+        texture = CreateRef<Texture>(filePath, AtlasSize, AtlasSize, empty.data(), mode == FontMode::SDF ? GL_LINEAR : GL_NEAREST);
+
+        AV_CORE_INFO("Loaded font {0}: {1} cells of {2}px.", filePath, cellsPerRow * cellsPerRow, cellSize);
+    }
+
+    const Character *rasterize(uint32_t codepoint) {
+        if (!face)
+            return nullptr;
 
-            uint32_t texture;
-            glGenTextures(1, &texture);
-            glBindTexture(GL_TEXTURE_2D, texture);
-            glTexImage2D(
-                    GL_TEXTURE_2D,
-                    0,
-                    GL_RED,
-                    face->glyph->bitmap.width,
-                    face->glyph->bitmap.rows,
-                    0,
-                    GL_RED,
-                    GL_UNSIGNED_BYTE,
-                    face->glyph->bitmap.buffer
-            );
-
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-            Character character = {
-                    texture,
-                    {face->glyph->bitmap.width, face->glyph->bitmap.rows},
-                    {face->glyph->bitmap_left, face->glyph->bitmap_top},
-                    static_cast<uint32_t>(face->glyph->advance.x)
-            };
-
-
-            characters[c] = character;
+        if (FT_Load_Char(face, codepoint, FT_LOAD_DEFAULT) ||
+            FT_Render_Glyph(face->glyph, mode == FontMode::SDF ? FT_RENDER_MODE_SDF : FT_RENDER_MODE_NORMAL)) {
+            AV_CORE_WARN("ERROR::FREETYPE: Failed to load Glyph for character: U+{0:04X}", codepoint);
+            failed.insert(codepoint);
+            return nullptr;
         }
 
-        FT_Done_Face(face);
+        const FT_Bitmap &bitmap = face->glyph->bitmap;
+        int width = static_cast<int>(bitmap.width), height = static_cast<int>(bitmap.rows);
+
+        Character character = {
+                {},
+                {width, height},
+                {face->glyph->bitmap_left, face->glyph->bitmap_top},
+                static_cast<uint32_t>(face->glyph->advance.x)
+        };
+
+        // spaces and control characters only advance the pen
+        if (width == 0 || height == 0)
+            return &(glyphs[codepoint] = {character, NoCell, frame, {}}).character;
+
+        if (width >= cellSize || height >= cellSize) {
+            AV_CORE_WARN("Glyph U+{0:04X} of {1} is larger than its atlas cell.", codepoint, filePath);
+            failed.insert(codepoint);
+            return nullptr;
+        }
+
+        uint32_t cell = acquireCell();
+        if (cell == NoCell) {
+            // warned once per run of full frames, the other glyphs of this frame are not rendered
+            if (fullFrame + 1 != frame)
+                AV_CORE_WARN("Font atlas of {0} is full of glyphs used this frame.", filePath);
+            fullFrame = frame;
+            return nullptr;
+        }
+
+        // the whole cell is written so that the pixels around the glyph are cleared
+        std::vector<uint8_t> pixels(static_cast<std::size_t>(cellSize) * cellSize * 4, 0);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                uint8_t *pixel = pixels.data() + (static_cast<std::size_t>(y) * cellSize + x) * 4;
+                pixel[0] = pixel[1] = pixel[2] = 255;
+                pixel[3] = bitmap.buffer[y * bitmap.pitch + x];
+            }
+        }
+
+        glm::ivec2 origin = cellOrigin(cell);
+        texture->setPixels(origin.x, origin.y, cellSize, cellSize, pixels.data());
+
+        // top-right, bottom-right, bottom-left, top-left, with v growing downwards like the pixel rows
+        float left = static_cast<float>(origin.x) / AtlasSize, right = static_cast<float>(origin.x + width) / AtlasSize;
+        float top = static_cast<float>(origin.y) / AtlasSize, bottom = static_cast<float>(origin.y + height) / AtlasSize;
+        character.texCoords = {glm::vec2(right, top), glm::vec2(right, bottom), glm::vec2(left, bottom), glm::vec2(left, top)};
+
+        lru.push_front(codepoint);
+        return &(glyphs[codepoint] = {character, cell, frame, lru.begin()}).character;
+    }
+
+    // a free cell, or the least recently used one if it was not used this frame
+    uint32_t acquireCell() {
+        if (usedCells < static_cast<uint32_t>(cellsPerRow * cellsPerRow))
+            return usedCells++;
+
+        if (lru.empty())
+            return NoCell;
+
+        auto evicted = glyphs.find(lru.back());
+        if (evicted->second.lastUsed == frame)
+            return NoCell;
+
+        uint32_t cell = evicted->second.cell;
+        lru.pop_back();
+        glyphs.erase(evicted);
+        return cell;
+    }
+
+    glm::ivec2 cellOrigin(uint32_t cell) const {
+        return {static_cast<int>(cell % cellsPerRow) * cellSize, static_cast<int>(cell / cellsPerRow) * cellSize};
     }
 
     static void loadLibs() {
@@ -97,13 +287,30 @@ private:
             AV_CORE_WARN("ERROR::FREETYPE: Could not init FreeType Library");
             return;
         }
-    }
 
+        // FreeType's default spread of 2 pixels is too narrow to scale text up
+        FT_Int spread = SdfSpread;
+        FT_Property_Set(ft, "sdf", "spread", &spread);
+        FT_Property_Set(ft, "bsdf", "spread", &spread);
+    }
 
-    uint32_t workingSize;
     std::string filePath;
-    std::map<char, Character> characters;
+    FontMode mode = FontMode::SDF;
+    uint32_t pixelSize = DefaultPixelSize;
+    float lineHeight = 0.0f;
+    FT_Face face = nullptr;
+
+    Ref<Texture> texture;
+    int cellSize = 0;
+    int cellsPerRow = 0;
+
+    std::unordered_map<uint32_t, Glyph> glyphs; // code point -> glyph
+    uint32_t usedCells = 0; // cells handed out at least once
+    std::list<uint32_t> lru; // code points of glyphs with a cell, most recently used first
+    std::unordered_set<uint32_t> failed; // code points that cannot be rendered, not tried again
+    uint64_t fullFrame = 0; // last frame the atlas had no cell left
 
-    static FT_Library ft;
+    inline static FT_Library ft = nullptr;
     inline static bool isLoaded = false;
+    inline static uint64_t frame = 1;
 };
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "avalon/core/Core.hpp"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+// The bundled glad loader targets the OpenGL 4.3 core profile without extensions. The entry points
+// below are newer (or extensions) and are loaded by hand in GLExtensions::load(); check the
+// matching `has*` flag before using any of them.
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef GLuint64 (APIENTRYP PFNGLGETTEXTUREHANDLEARBPROC)(GLuint texture);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)(GLuint64 handle);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORMHANDLEUI64VARBPROC)(GLuint program, GLint location, GLsizei count, const GLuint64 *values);
+
+class GLExtensions {
+public:
+
+    // glBufferStorage, core in 4.4 or GL_ARB_buffer_storage
+    inline static bool hasBufferStorage = false;
+    inline static PFNGLBUFFERSTORAGEPROC bufferStorage = nullptr;
+
+    // GL_ARB_bindless_texture
+    inline static bool hasBindlessTexture = false;
+    inline static PFNGLGETTEXTUREHANDLEARBPROC getTextureHandle = nullptr;
+    inline static PFNGLMAKETEXTUREHANDLERESIDENTARBPROC makeTextureHandleResident = nullptr;
+    inline static PFNGLPROGRAMUNIFORMHANDLEUI64VARBPROC programUniformHandleui64v = nullptr;
+
+    // GL_KHR_parallel_shader_compile (or the ARB version): compile status can be polled with
+    // GL_COMPLETION_STATUS_KHR without blocking
+    inline static bool hasParallelShaderCompile = false;
+    inline static PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads = nullptr;
+
+    /**
+     * Must be called once the context is current and glad is loaded.
+     */
+    static void load() {
+        if (isVersion(4, 4) || isSupported("GL_ARB_buffer_storage")) {
+            bufferStorage = reinterpret_cast<PFNGLBUFFERSTORAGEPROC>(glfwGetProcAddress("glBufferStorage"));
+            hasBufferStorage = bufferStorage != nullptr;
+        }
+
+        if (isSupported("GL_ARB_bindless_texture")) {
+            getTextureHandle = reinterpret_cast<PFNGLGETTEXTUREHANDLEARBPROC>(glfwGetProcAddress("glGetTextureHandleARB"));
+            makeTextureHandleResident = reinterpret_cast<PFNGLMAKETEXTUREHANDLERESIDENTARBPROC>(glfwGetProcAddress("glMakeTextureHandleResidentARB"));
+            programUniformHandleui64v = reinterpret_cast<PFNGLPROGRAMUNIFORMHANDLEUI64VARBPROC>(glfwGetProcAddress("glProgramUniformHandleui64vARB"));
+            hasBindlessTexture = getTextureHandle && makeTextureHandleResident && programUniformHandleui64v;
+        }
+
+        if (isSupported("GL_KHR_parallel_shader_compile")) {
+            maxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(glfwGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+        } else if (isSupported("GL_ARB_parallel_shader_compile")) {
+            maxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(glfwGetProcAddress("glMaxShaderCompilerThreadsARB"));
+        }
+
+        // let the driver pick the number of compiler threads
+        hasParallelShaderCompile = maxShaderCompilerThreads != nullptr;
+        if (hasParallelShaderCompile)
+            maxShaderCompilerThreads(0xFFFFFFFF);
+
+        AV_CORE_INFO("Persistent mapped buffers: {0}.", hasBufferStorage ? "yes" : "no");
+        AV_CORE_INFO("Bindless textures: {0}.", hasBindlessTexture ? "yes" : "no");
+        AV_CORE_INFO("Parallel shader compile: {0}.", hasParallelShaderCompile ? "yes" : "no");
+    }
+
+    static bool isVersion(int major, int minor) {
+        return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+    }
+
+    static bool isSupported(const std::string &extension) {
+        int count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+        for (int i = 0; i < count; i++) {
+            auto name = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+            if (name && extension == name)
+                return true;
+        }
+        return false;
+    }
+};
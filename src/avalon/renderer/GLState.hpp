@@ -0,0 +1,196 @@
+#pragma once
+
+#include "avalon/core/Core.hpp"
+
+#include <glad/glad.h>
+
+/**
+ * Shadow copy of the GL state the renderer changes: program, vertex array, buffer bindings, textures
+ * per unit, blending and viewport. Renderer classes change that state only through here, so a call
+ * setting what is already set never reaches the driver.
+ *
+ * Code changing GL state behind the cache (ImGui, FrameBuffer, third party code) must be followed by
+ * invalidate(); the Renderer invalidates at the start of every flush.
+ */
+class GLState {
+public:
+
+    struct Counters {
+        uint64_t issued = 0; // calls sent to GL
+        uint64_t elided = 0; // calls skipped because the state was already set
+    };
+
+    static void useProgram(GLuint program) {
+        if (track(state.program, program))
+            glUseProgram(program);
+    }
+
+    static void bindVertexArray(GLuint vertexArray) {
+        if (track(state.vertexArray, vertexArray)) {
+            glBindVertexArray(vertexArray);
+
+            // the element buffer binding belongs to the vertex array
+            state.elementBuffer = Unknown;
+        }
+    }
+
+    static void bindBuffer(GLenum target, GLuint buffer) {
+        GLuint *binding = bufferBinding(target);
+        if (binding != nullptr && !track(*binding, buffer))
+            return;
+
+        if (binding == nullptr)
+            counters.issued++;
+        glBindBuffer(target, buffer);
+    }
+
+    /**
+     * Binds a 2D texture to a texture unit for drawing, selecting the unit only when the binding
+     * changes. Use selectTexture before editing a texture.
+     */
+    static void bindTexture(uint32_t unit, GLuint texture) {
+        if (unit >= state.textures.size())
+            state.textures.resize(unit + 1, Unknown);
+
+        if (!track(state.textures[unit], texture))
+            return;
+
+        if (state.activeUnit != unit) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            state.activeUnit = unit;
+            counters.issued++;
+        }
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+
+    /**
+     * Makes `unit` the active unit and binds the texture to it, always reaching GL. For code editing
+     * the texture afterwards (glTexImage2D, glTexSubImage2D, glTexParameteri), which acts on the
+     * active unit: bindTexture may skip selecting it when the texture is already bound there, and
+     * code behind the cache may have changed either since.
+     */
+    static void selectTexture(uint32_t unit, GLuint texture) {
+        if (unit >= state.textures.size())
+            state.textures.resize(unit + 1, Unknown);
+
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        state.activeUnit = unit;
+        state.textures[unit] = texture;
+        counters.issued += 2;
+    }
+
+    static void setBlend(bool enabled, GLenum source = GL_SRC_ALPHA, GLenum destination = GL_ONE_MINUS_SRC_ALPHA) {
+        if (track(state.blend, enabled ? 1u : 0u)) {
+            if (enabled)
+                glEnable(GL_BLEND);
+            else
+                glDisable(GL_BLEND);
+        }
+
+        if (enabled && track(state.blendFunc, static_cast<uint64_t>(source) << 32 | destination))
+            glBlendFunc(source, destination);
+    }
+
+    static void setViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+        std::array<GLint, 4> viewport{x, y, width, height};
+        if (state.viewport == viewport) {
+            counters.elided++;
+            return;
+        }
+
+        state.viewport = viewport;
+        counters.issued++;
+        glViewport(x, y, width, height);
+    }
+
+    /**
+     * Forgets the cached state, the next call of every kind reaches GL.
+     */
+    static void invalidate() {
+        state = {};
+    }
+
+    // deleted objects are unbound by GL, and their names may be reused
+    static void onDeleteProgram(GLuint program) {
+        forget(state.program, program);
+    }
+
+    static void onDeleteVertexArray(GLuint vertexArray) {
+        forget(state.vertexArray, vertexArray);
+    }
+
+    static void onDeleteBuffer(GLuint buffer) {
+        forget(state.arrayBuffer, buffer);
+        forget(state.elementBuffer, buffer);
+        forget(state.uniformBuffer, buffer);
+    }
+
+    static void onDeleteTexture(GLuint texture) {
+        for (auto &binding: state.textures)
+            forget(binding, texture);
+    }
+
+    static const Counters &getCounters() {
+        return counters;
+    }
+
+    static void resetCounters() {
+        counters = {};
+    }
+
+private:
+    static constexpr GLuint Unknown = UINT32_MAX;
+
+    struct State {
+        GLuint program = Unknown;
+        GLuint vertexArray = Unknown;
+        GLuint arrayBuffer = Unknown;
+        GLuint elementBuffer = Unknown;
+        GLuint uniformBuffer = Unknown;
+        uint32_t activeUnit = Unknown;
+        std::vector<GLuint> textures; // per unit
+        GLuint blend = Unknown;
+        uint64_t blendFunc = UINT64_MAX;
+        std::array<GLint, 4> viewport{-1, -1, -1, -1};
+    };
+
+    // records the new value, true when it differs and the call must be issued
+    template<typename T>
+    static bool track(T &current, T value) {
+        if (current == value) {
+            counters.elided++;
+            return false;
+        }
+
+        current = value;
+        counters.issued++;
+        return true;
+    }
+
+    static void forget(GLuint &binding, GLuint object) {
+        if (binding == object)
+            binding = Unknown;
+    }
+
+    // cached binding of a target, nullptr for the targets not cached
+    static GLuint *bufferBinding(GLenum target) {
+        switch (target) {
+            case GL_ARRAY_BUFFER:
+                return &state.arrayBuffer;
+            case GL_ELEMENT_ARRAY_BUFFER:
+                return &state.elementBuffer;
+            case GL_UNIFORM_BUFFER:
+                return &state.uniformBuffer;
+            default:
+                return nullptr;
+        }
+    }
+
+    static State state;
+    static Counters counters;
+};
+
+// defined out of the class, the member initializers of the nested structs are not usable inside it
+inline GLState::State GLState::state;
+inline GLState::Counters GLState::counters;
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Batch.hpp"
+
+#include <glm/gtc/packing.hpp>
+
+/**
+ * Batch writing one 32 byte instance per quad and drawing all of them with a single instanced
+ * triangle strip. Expansion to corners, rotation and texture coordinate lookup run in the vertex
+ * shader (instanced.glsl), so the CPU work per quad is packing a few fields.
+ */
+class InstanceBatch : public Batch {
+public:
+
+    InstanceBatch(int32_t maxBatchSize, Ref<Shader> instanceShader) : Batch(maxBatchSize, std::move(instanceShader)) {
+        instances.reserve(maxBatchSize);
+
+        createBuffers(sizeof(Instance), maxBatchSize);
+
+        // bind position on location 0
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *) offsetof(Instance, position));
+
+        // bind half float scale on location 1
+        glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(Instance), (void *) offsetof(Instance, scale));
+
+        // bind the 16 bit texture rectangle (top-right u/v, bottom-left u/v) on location 2, normalized to [0, 1]
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Instance), (void *) offsetof(Instance, texRect));
+
+        // bind RGBA8 color on location 3, normalized to [0, 1]
+        glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance), (void *) offsetof(Instance, color));
+
+        // bind texture slot | shape | rotation on location 4, read as an integer
+        glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(Instance), (void *) offsetof(Instance, packed));
+
+        // every attribute advances once per instance
+        for (GLuint location = 0; location < 5; location++) {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+
+        GLState::bindVertexArray(0); // Unbind the VAO
+        GLState::bindBuffer(GL_ARRAY_BUFFER, 0); // Unbind the VBO
+    }
+
+    void addShape(const glm::vec3 &position, const glm::vec2 &scale, float rotation, uint32_t shape, const glm::vec4 &color, const Ref<Texture> &texture, const std::array<glm::vec2, 4> &texCoords) override {
+        uint32_t texId = acquireTextureSlot(texture);
+
+        // corners are top-right, bottom-right, bottom-left, top-left: the rectangle is spanned by 0 and 2
+        instances.push_back({
+                position,
+                glm::packHalf2x16(scale),
+                {packUnorm16(texCoords[0].x), packUnorm16(texCoords[0].y), packUnorm16(texCoords[2].x), packUnorm16(texCoords[2].y)},
+                packColor(color),
+                packAttributes(texId, shape, rotation)
+        });
+
+        quadCount++;
+    }
+
+protected:
+
+    std::span<const std::byte> getRecords() const override {
+        return std::as_bytes(std::span(instances));
+    }
+
+    void clearRecords() override {
+        instances.clear();
+    }
+
+    void draw(uint32_t first) override {
+        // the base instance selects the region
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(quadCount), first);
+    }
+
+private:
+
+    /**
+     * 32 bytes per quad. `packed` holds the texture slot in bits 0-7, the shape in bits 8-15 and the
+     * rotation in bits 16-31 as a fraction of a full turn, unpacked in instanced.glsl.
+     */
+    struct Instance {
+        glm::vec3 position;
+        uint32_t scale; // half2
+        std::array<uint16_t, 4> texRect; // unorm16
+        uint32_t color; // RGBA8
+        uint32_t packed;
+    };
+
+    static_assert(sizeof(Instance) == 32);
+
+    static uint32_t packAttributes(uint32_t texSlot, uint32_t shape, float rotation) {
+        float turns = rotation / 360.0f;
+        auto angle = static_cast<uint32_t>(static_cast<int64_t>(std::round((turns - std::floor(turns)) * 65536.0f)) & 0xFFFF);
+        return (texSlot & 0xFF) | (shape & 0xFF) << 8 | angle << 16;
+    }
+
+    std::vector<Instance> instances;
+};
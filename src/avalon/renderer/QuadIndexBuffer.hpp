@@ -0,0 +1,72 @@
+#pragma once
+
+#include "avalon/core/Core.hpp"
+#include "GLState.hpp"
+
+#include <glad/glad.h>
+
+/**
+ * Element buffer shared by every quad batch. The index pattern of a quad never changes (two triangles
+ * 0-1-2 / 2-3-0 offset by 4 per quad), so it is generated once for the largest batch and bound into
+ * each batch's VAO. Indices are 16 bit whenever the batch's vertices fit in that range; batches draw
+ * their ring regions with a base vertex, so the indices never exceed one batch.
+ */
+class QuadIndexBuffer {
+public:
+
+    /**
+     * Makes sure the buffer covers batches of maxQuads quads. Must be called with a current context.
+     */
+    static void reserve(uint32_t maxQuads) {
+        if (maxQuads <= capacity)
+            return;
+
+        if (!EBO)
+            glGenBuffers(1, &EBO);
+
+        // the buffer name is kept when growing, so VAOs already referencing it stay valid
+        GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        if (maxQuads * 4 <= 65536) {
+            upload<uint16_t>(maxQuads);
+            type = GL_UNSIGNED_SHORT;
+        } else {
+            upload<uint32_t>(maxQuads);
+            type = GL_UNSIGNED_INT;
+        }
+
+        capacity = maxQuads;
+        AV_CORE_INFO("Quad index buffer: {0} quads, {1} bit indices.", capacity, type == GL_UNSIGNED_SHORT ? 16 : 32);
+    }
+
+    /**
+     * Binds the buffer to GL_ELEMENT_ARRAY_BUFFER, which attaches it to the currently bound VAO.
+     */
+    static void bind() {
+        GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    }
+
+    static GLenum getType() {
+        return type;
+    }
+
+private:
+    template<typename Index>
+    static void upload(uint32_t quads) {
+        std::vector<Index> indices(quads * 6);
+        for (uint32_t quad = 0, i = 0; quad < quads; quad++, i += 6) {
+            auto vertex = static_cast<Index>(quad * 4);
+            indices[i] = vertex;
+            indices[i + 1] = vertex + 1;
+            indices[i + 2] = vertex + 2;
+            indices[i + 3] = vertex + 2;
+            indices[i + 4] = vertex + 3;
+            indices[i + 5] = vertex;
+        }
+
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(Index), indices.data(), GL_STATIC_DRAW);
+    }
+
+    inline static GLuint EBO = 0;
+    inline static GLenum type = GL_UNSIGNED_SHORT;
+    inline static uint32_t capacity = 0;
+};
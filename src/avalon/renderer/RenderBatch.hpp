@@ -1,190 +1,113 @@
 #pragma once
 
-#include "Texture.hpp"
-#include "Shader.hpp"
-#include "Camera.hpp"
-#include "Font.hpp"
-#include "Color.hpp"
-#include "avalon/utils/PlatformUtils.hpp"
-
-class RenderBatch {
+#include "Batch.hpp"
+#include "QuadIndexBuffer.hpp"
+
+/**
+ * Batch expanding every quad into 4 vertices on the CPU. Indices come from the shared
+ * QuadIndexBuffer, only vertices are written per frame.
+ */
+class RenderBatch : public Batch {
 public:
-    RenderBatch() = default;
 
-    RenderBatch(int32_t maxBatchSize, Ref<Shader> quadShader, int zIndex) : maxBatchSize(maxBatchSize), shader(std::move(quadShader)), zIndex(zIndex) {
+    RenderBatch(int32_t maxBatchSize, Ref<Shader> quadShader) : Batch(maxBatchSize, std::move(quadShader)) {
         vertices.reserve(maxBatchSize * 4); // 4 vertices per quad
-        indices.reserve(maxBatchSize * 6); // 6 indices per quad
-    }
-
-    ~RenderBatch() {
-        if (VAO) glDeleteVertexArrays(1, &VAO);
-        if (VBO) glDeleteBuffers(1, &VBO);
-        if (EBO) glDeleteBuffers(1, &EBO);
-    }
-
 
-    void start() {
-        // Create and bind the Vertex Array Object (VAO)
-        glGenVertexArrays(1, &VAO);
-        glBindVertexArray(VAO);
+        createBuffers(sizeof(Vertex), maxBatchSize * 4);
 
-        // Generate and bind the Vertex Buffer Object (VBO)
-        glGenBuffers(1, &VBO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
-
-        // Generate and bind the Element Buffer Object (EBO)
-        glGenBuffers(1, &EBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+        // the element buffer is shared by all batches
+        QuadIndexBuffer::bind();
 
         // bind position on location 0
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, position));
         glEnableVertexAttribArray(0);
 
-        // bind color on location 1
-        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, color));
+        // bind RGBA8 color on location 1, normalized to [0, 1]
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void *) offsetof(Vertex, color));
         glEnableVertexAttribArray(1);
 
-        // bind texture coordinates on location 2
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, texCoords));
+        // bind 16 bit texture coordinates on location 2, normalized to [0, 1]
+        glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Vertex), (void *) offsetof(Vertex, texCoords));
         glEnableVertexAttribArray(2);
 
-        // bind texID on location 3
-        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, texID));
+        // bind texture slot | shape | flags on location 3, read as an integer
+        glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(Vertex), (void *) offsetof(Vertex, packed));
         glEnableVertexAttribArray(3);
 
-        // bind normalized flag on location 4
-        glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, shape));
-        glEnableVertexAttribArray(4);
-
-        glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind the VBO
-        glBindVertexArray(0); // Unbind the VAO
+        GLState::bindVertexArray(0); // Unbind the VAO, it keeps the EBO binding
+        GLState::bindBuffer(GL_ARRAY_BUFFER, 0); // Unbind the VBO
     }
 
-
-    void addShape(const glm::vec2 &position, const glm::vec2 &scale, float rotation, uint32_t shape, const glm::vec4 &color, const Ref<Texture> &texture, const std::array<glm::vec2, 4> &texCoords) {
-        int texId = 0;
-
-        // Handle texture binding
-        if (texture != nullptr) {
-            if (std::find(textures.begin(), textures.end(), texture) == textures.end())
-                textures.push_back(texture);
-
-            for (int i = 0; i < textures.size(); i++) {
-                if (textures[i] == texture) {
-                    texId = i + 1;
-                    break;
-                }
-            }
-        }
-
-        float radians = glm::radians(rotation);
-
-        glm::mat2 rotationMatrix = glm::mat2(
-                glm::cos(radians), -glm::sin(radians),
-                glm::sin(radians),  glm::cos(radians)
-        );
-
+    void addShape(const glm::vec3 &position, const glm::vec2 &scale, float rotation, uint32_t shape, const glm::vec4 &color, const Ref<Texture> &texture, const std::array<glm::vec2, 4> &texCoords) override {
+        uint32_t texId = acquireTextureSlot(texture);
 
         glm::vec2 halfScale = 0.5f * scale;
 
         glm::vec2 verticesPos[4] = {
-                rotationMatrix * glm::vec2(halfScale.x, halfScale.y),    // Top-right
-                rotationMatrix * glm::vec2(halfScale.x, -halfScale.y),   // Bottom-right
-                rotationMatrix * glm::vec2(-halfScale.x, -halfScale.y),  // Bottom-left
-                rotationMatrix * glm::vec2(-halfScale.x, halfScale.y)    // Top-left
+                glm::vec2(halfScale.x, halfScale.y),    // Top-right
+                glm::vec2(halfScale.x, -halfScale.y),   // Bottom-right
+                glm::vec2(-halfScale.x, -halfScale.y),  // Bottom-left
+                glm::vec2(-halfScale.x, halfScale.y)    // Top-left
         };
 
-        // Add vertices to the batch with the position offset applied
-        for (int i = 0; i < 4; ++i) {
-            vertices.emplace_back(glm::vec3{position + verticesPos[i], zIndex}, color, texCoords[i], texId, shape);
-        }
-
-        // Add indices for the two triangles that form the quad
-        indices.insert(indices.end(), {
-                vertexIndex, vertexIndex + 1, vertexIndex + 2,
-                vertexIndex + 2, vertexIndex + 3, vertexIndex
-        });
-
-        vertexIndex += 4;
-
-        if (vertexIndex >= maxBatchSize)
-            full = true;
-    }
-
-
-    void render(int screenWidth, int screenHeight, Camera &camera) {
+        // most quads are not rotated, skip the trigonometry for them
+        if (rotation != 0.0f) {
+            float radians = glm::radians(rotation);
 
-        //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        shader->bind();
+            glm::mat2 rotationMatrix = glm::mat2(
+                    glm::cos(radians), -glm::sin(radians),
+                    glm::sin(radians),  glm::cos(radians)
+            );
 
-        camera.applyViewport(screenWidth, screenHeight);
-        shader->uploadMat4f("uWorldProjection", camera.getProjectionMatrix());
-        shader->uploadMat4f("uView", camera.getViewMatrix());
-        shader->uploadFloat("uTime", Time::getTime());
-
-        for (int i = 0; i < textures.size(); i++) {
-            glActiveTexture(GL_TEXTURE0 + i + 1);
-            textures[i]->bind();
+            for (auto &vertex: verticesPos)
+                vertex = rotationMatrix * vertex;
         }
 
-        shader->uploadIntArray("uTextures", texSlots, 16);
-
-        glBindVertexArray(VAO);
+        uint32_t packedColor = packColor(color);
+        uint32_t packed = packAttributes(texId, shape, 0);
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(Vertex), vertices.data());
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indices.size() * sizeof(uint32_t), indices.data());
-
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-
-        for (int i = 0; i < textures.size(); i++) {
-            textures[i]->unbind();
+        // Add vertices to the batch with the position offset applied
+        for (int i = 0; i < 4; ++i) {
+            vertices.push_back({glm::vec3{glm::vec2(position) + verticesPos[i], position.z}, packedColor, {packUnorm16(texCoords[i].x), packUnorm16(texCoords[i].y)}, packed});
         }
 
-        glBindVertexArray(0);
+        quadCount++;
     }
 
-    bool hasTextureRoom() {
-        return textures.size() < 8;
-    }
+protected:
 
-    bool hasTexture(const Ref<Texture> &texture) {
-        return std::find(textures.begin(), textures.end(), texture) != textures.end();
+    std::span<const std::byte> getRecords() const override {
+        return std::as_bytes(std::span(vertices));
     }
 
-    bool isFull() const {
-        return full;
+    void clearRecords() override {
+        vertices.clear();
     }
 
-    int getZIndex() const {
-        return zIndex;
+    void draw(uint32_t first) override {
+        // 6 indices per quad, the base vertex selects the region
+        glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(quadCount * 6), QuadIndexBuffer::getType(), nullptr,
+                                 static_cast<GLint>(first));
     }
 
 private:
 
+    /**
+     * 24 bytes per vertex. `packed` holds the texture slot in bits 0-7, the shape in bits 8-15 and
+     * flags in bits 16-31, unpacked in render.glsl.
+     */
     struct Vertex {
         glm::vec3 position;
-        glm::vec4 color;
-        glm::vec2 texCoords;
-        float texID;
-        int32_t shape;
+        uint32_t color;        // RGBA8
+        std::array<uint16_t, 2> texCoords; // unorm16
+        uint32_t packed;
     };
 
-    uint32_t maxBatchSize = 0;
-    uint32_t zIndex{};
-    bool full = false;
+    static_assert(sizeof(Vertex) == 24);
 
-    GLuint VAO{}, VBO{}, EBO{};
+    static uint32_t packAttributes(uint32_t texSlot, uint32_t shape, uint32_t flags) {
+        return (texSlot & 0xFF) | (shape & 0xFF) << 8 | (flags & 0xFFFF) << 16;
+    }
 
     std::vector<Vertex> vertices;
-    uint32_t vertexIndex = 0; // holds the drawing index in the element array
-    std::vector<uint32_t> indices;
-
-    Ref<Shader> shader;
-    std::vector<Ref<Texture>> textures;
-    int texSlots[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
 };
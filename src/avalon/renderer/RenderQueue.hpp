@@ -0,0 +1,167 @@
+#pragma once
+
+#include "Texture.hpp"
+#include "Sprite.hpp"
+
+#include <bit>
+#include <limits>
+
+enum class BlendMode : uint8_t {
+    Alpha,    // src * a + dst * (1 - a)
+    Additive, // src * a + dst
+    Multiply, // src * dst
+    Opaque    // blending disabled
+};
+
+/**
+ * A shape submitted to the Renderer, kept until the frame is flushed.
+ */
+struct RenderCommand {
+    glm::vec3 position;
+    glm::vec2 scale;
+    float rotation;
+    uint32_t shape;
+    glm::vec4 color;
+    Ref<Texture> texture;
+    TextureCoords texCoords;
+    uint8_t shader;
+    BlendMode blend;
+};
+
+/**
+ * Commands of one frame along with a 64 bit sort key each. The key orders draws by, from most to
+ * least significant bits:
+ *
+ *   layer (8) | z, higher first (24) | shader (8) | blend mode (4) | texture (20)
+ *
+ * so once sorted, consecutive commands share as much GPU state as the painter's order allows and the
+ * Renderer can merge them into few draw calls. Keys are sorted with a stable LSD radix sort, commands
+ * with equal keys keep their submission order.
+ */
+class RenderQueue {
+public:
+    struct Entry {
+        uint64_t key;
+        uint32_t index; // position of the command in getCommands()
+    };
+
+    static uint64_t makeKey(uint8_t layer, float z, uint8_t shader, BlendMode blend, uint32_t texture) {
+        // float bits mapped so that unsigned order matches float order, the top 24 bits are kept
+        uint32_t bits = std::bit_cast<uint32_t>(z);
+        bits = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+        uint32_t depth = 0xFFFFFFu - (bits >> 8); // descending: higher z first
+
+        return static_cast<uint64_t>(layer) << 56
+               | static_cast<uint64_t>(depth) << 32
+               | static_cast<uint64_t>(shader) << 24
+               | static_cast<uint64_t>(static_cast<uint8_t>(blend) & 0xF) << 20
+               | (texture & 0xFFFFFu);
+    }
+
+    void push(uint64_t key, RenderCommand &&command) {
+        // axis aligned bounds of the (rotated) quad, kept as structure of arrays for cull()
+        glm::vec2 extent = 0.5f * command.scale;
+        if (command.rotation != 0.0f) {
+            float radians = glm::radians(command.rotation);
+            float c = std::abs(glm::cos(radians)), s = std::abs(glm::sin(radians));
+            extent = {c * extent.x + s * extent.y, s * extent.x + c * extent.y};
+        }
+
+        minX.push_back(command.position.x - extent.x);
+        minY.push_back(command.position.y - extent.y);
+        maxX.push_back(command.position.x + extent.x);
+        maxY.push_back(command.position.y + extent.y);
+
+        entries.push_back({key, static_cast<uint32_t>(commands.size())});
+        commands.push_back(std::move(command));
+    }
+
+    /**
+     * Drops the entries whose bounds do not overlap the rectangle, before sort() so culled commands are
+     * never sorted. Returns the number of entries dropped.
+     */
+    uint32_t cull(const glm::vec2 &min, const glm::vec2 &max) {
+        std::size_t count = commands.size();
+
+        // blocks of 8 without a tail: the padding boxes are empty and never visible
+        std::size_t padded = (count + 7) & ~std::size_t(7);
+        constexpr float inf = std::numeric_limits<float>::infinity();
+        minX.resize(padded, inf);
+        minY.resize(padded, inf);
+        maxX.resize(padded, -inf);
+        maxY.resize(padded, -inf);
+
+        std::size_t kept = 0;
+        for (std::size_t block = 0; block < padded; block += 8) {
+            // fixed width and branch free, compiled to SIMD compares
+            uint8_t visible[8];
+            for (std::size_t lane = 0; lane < 8; lane++) {
+                std::size_t i = block + lane;
+                visible[lane] = (minX[i] <= max.x) & (maxX[i] >= min.x) & (minY[i] <= max.y) & (maxY[i] >= min.y);
+            }
+
+            for (std::size_t lane = 0; lane < 8 && block + lane < count; lane++) {
+                entries[kept] = entries[block + lane];
+                kept += visible[lane];
+            }
+        }
+
+        auto culled = static_cast<uint32_t>(entries.size() - kept);
+        entries.resize(kept);
+        return culled;
+    }
+
+    /**
+     * Sorts the keys and returns the sorted entries, whose `index` points into getCommands().
+     */
+    const std::vector<Entry> &sort() {
+        scratch.resize(entries.size());
+
+        for (uint32_t shift = 0; shift < 64; shift += 8) {
+            std::array<uint32_t, 256> counts{};
+            for (const auto &entry: entries)
+                counts[(entry.key >> shift) & 0xFF]++;
+
+            // every key has the same byte here, the pass would not move anything
+            if (counts[(entries.empty() ? 0 : entries[0].key >> shift) & 0xFF] == entries.size())
+                continue;
+
+            uint32_t offset = 0;
+            for (auto &count: counts) {
+                uint32_t next = offset + count;
+                count = offset;
+                offset = next;
+            }
+
+            for (const auto &entry: entries)
+                scratch[counts[(entry.key >> shift) & 0xFF]++] = entry;
+
+            entries.swap(scratch);
+        }
+
+        return entries;
+    }
+
+    const std::vector<RenderCommand> &getCommands() const {
+        return commands;
+    }
+
+    std::size_t size() const {
+        return commands.size();
+    }
+
+    void clear() {
+        entries.clear();
+        commands.clear();
+        minX.clear();
+        minY.clear();
+        maxX.clear();
+        maxY.clear();
+    }
+
+private:
+    std::vector<Entry> entries;
+    std::vector<Entry> scratch;
+    std::vector<RenderCommand> commands;
+    std::vector<float> minX, minY, maxX, maxY; // bounds of every command
+};
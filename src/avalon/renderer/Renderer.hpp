@@ -1,79 +1,246 @@
 #pragma once
 
 #include "RenderBatch.hpp"
+#include "InstanceBatch.hpp"
+#include "RenderQueue.hpp"
+#include "Shape.hpp"
+#include "UniformBuffer.hpp"
 #include "avalon/utils/AssetPool.hpp"
 
-enum Shape : uint32_t {
-    QUAD,
-    CIRCLE
+
+/**
+ * How batches turn quads into GPU data: Vertices expands each quad into 4 vertices on the CPU
+ * (RenderBatch), Instanced writes one instance per quad and expands it in the vertex shader
+ * (InstanceBatch).
+ */
+enum class RenderBackend {
+    Vertices,
+    Instanced
+};
+
+/**
+ * Options applied when the first Renderer initializes GL, see Renderer::configure.
+ */
+struct RendererConfig {
+    // texture handles of GL_ARB_bindless_texture instead of texture units, if the driver has them:
+    // Batch::BindlessTextureSlots textures per batch whatever the number of units
+    bool bindlessTextures = false;
 };
 
+/**
+ * Frame uniform block of the shaders (std140), written once per flush.
+ */
+struct FrameUniforms {
+    glm::mat4 worldProjection;
+    glm::mat4 view;
+    float time;
+    float padding[3];
+};
+
+static_assert(sizeof(FrameUniforms) == 144);
+
+/**
+ * Counters of the last flushed frame.
+ */
+struct RenderStats {
+    uint32_t submitted = 0; // shapes drawn through the renderer
+    uint32_t culled = 0;    // submitted shapes outside the camera view
+    uint32_t drawn = 0;     // submitted shapes sent to the GPU
+    uint32_t drawCalls = 0;
+    uint64_t stateCalls = 0;  // GL state changes issued through GLState
+    uint64_t stateElided = 0; // redundant GL state changes skipped by GLState
+};
+
+/**
+ * Records shapes in a RenderQueue during the frame and draws them on flush. The queue is sorted once
+ * per frame by layer, z (higher first), shader, blend mode and texture; consecutive shapes are then
+ * merged into the same batch until the shader or blend mode changes, the batch is full or it runs out
+ * of texture slots, which gives the fewest draw calls the painter's order allows.
+ *
+ * Layer, shader and blend mode are state: they apply to every shape drawn after they are set.
+ */
 class Renderer {
 public:
     Renderer() = default;
 
-    Renderer(int32_t maxBatchSize, const glm::vec4 clearColor = {0.0863f, 0.0863f, 0.0863f, 1.0f}) : maxBatchSize(maxBatchSize), clearColor(clearColor) {
+    Renderer(int32_t maxBatchSize, RenderBackend backend = RenderBackend::Vertices, const glm::vec4 clearColor = {0.0863f, 0.0863f, 0.0863f, 1.0f})
+            : maxBatchSize(maxBatchSize), backend(backend), clearColor(clearColor) {
         if (!initialized) {
             Renderer::init();
             initialized = true;
         }
+
+        // instanced batches draw triangle strips without indices
+        if (backend == RenderBackend::Vertices)
+            QuadIndexBuffer::reserve(maxBatchSize);
+
+        // shader 0 is the backend's own
+        shaders.push_back(AssetPool::getBundle("resources")->getShader(backend == RenderBackend::Instanced ? "instanced" : "render"));
     }
 
 
     void draw(const glm::vec3 &position, const glm::vec2 &scale, float rotation, Shape shape, const glm::vec4 color, const Ref<Texture> &texture, const TextureCoords &texCoords) {
+        uint32_t textureId = texture != nullptr ? texture->getID() : 0;
+
+        queue.push(RenderQueue::makeKey(layer, position.z, shaderIndex, blendMode, textureId),
+                   {position, scale, rotation, shape, color, texture, texCoords, shaderIndex, blendMode});
+    }
 
-        float zIndex = position.z;
+    void drawQuad(const glm::vec3 &position, const glm::vec2 size, const glm::vec4 &color, const Sprite& sprite = Sprite(nullptr)) {
+        draw(position, size, 0.0f, Shape::QUAD, color, sprite.texture, sprite.texCoords);
+    }
 
-        bool added = false;
-        for (auto &x: batches) {
-            if (!x.isFull() && x.getZIndex() == zIndex) {
+    void drawRotatedQuad(const glm::vec3 &position, const glm::vec2 size, float rotation, const glm::vec4 &color, const Sprite& sprite = Sprite(nullptr)) {
+        draw(position, size, rotation, Shape::QUAD, color, sprite.texture, sprite.texCoords);
+    }
+
+    /**
+     * Draws UTF-8 text from its first baseline at `position`, `size` world units high per line of the
+     * font's pixel size. Every glyph is a quad of the font atlas, so text batches with everything else.
+     */
+    void drawText(const glm::vec3 &position, float size, const glm::vec4 &color, Font &font, std::string_view text) {
+        if (font.getTexture() == nullptr)
+            return;
 
-                // if quad has no texture
-                if (texture == nullptr || (x.hasTexture(texture) || x.hasTextureRoom())) {
-                    x.addShape(position, scale, rotation, shape, color, texture, texCoords);
-                    added = true;
-                    break;
-                }
+        float scale = size / static_cast<float>(font.getPixelSize());
+        glm::vec2 pen = position;
+
+        for (std::size_t offset = 0; offset < text.size();) {
+            uint32_t codepoint = Font::decodeUtf8(text, offset);
+            if (codepoint == '\n') {
+                pen = {position.x, pen.y - font.getLineHeight() * scale};
+                continue;
             }
-        }
 
-        if (!added) {
-            batches.emplace_back(maxBatchSize, AssetPool::getBundle("resources")->getShader("render"), zIndex);
-            batches.back().addShape(position, scale, rotation, shape, color, texture, texCoords);
-        }
+            const Character *character = font.getCharacter(codepoint);
+            if (character == nullptr)
+                continue;
+
+            if (character->size.x > 0 && character->size.y > 0) {
+                glm::vec2 glyphSize = glm::vec2(character->size) * scale;
+                glm::vec2 center = {pen.x + character->bearing.x * scale + 0.5f * glyphSize.x,
+                                    pen.y + character->bearing.y * scale - 0.5f * glyphSize.y};
+
+                draw({center, position.z}, glyphSize, 0.0f, font.getShape(), color, font.getTexture(), character->texCoords);
+            }
 
+            // advance is in 1/64 pixels
+            pen.x += static_cast<float>(character->advance >> 6) * scale;
+        }
     }
 
-    void drawQuad(const glm::vec3 &position, const glm::vec2 size, const glm::vec4 &color, const Sprite& sprite = Sprite(nullptr)) {
-        draw(position, size, 0.0f, Shape::QUAD, color, sprite.texture, sprite.texCoords);
+    /**
+     * Layers are drawn in increasing order, each one on top of the previous ones whatever their z.
+     */
+    void setLayer(uint8_t drawLayer) {
+        layer = drawLayer;
     }
 
-    void drawRotatedQuad(const glm::vec3 &position, const glm::vec2 size, float rotation, const glm::vec4 &color, const Sprite& sprite = Sprite(nullptr)) {
-        draw(position, size, rotation, Shape::QUAD, color, sprite.texture, sprite.texCoords);
+    void setBlendMode(BlendMode mode) {
+        blendMode = mode;
     }
 
-    void drawText(const glm::vec3 &position, const glm::ivec2 &size, const glm::vec4 &color, const Font &font, const std::string &text, bool normalized = false) {
+    /**
+     * Shader used for the next shapes, nullptr restores the default one. It must accept the vertex
+     * layout of the renderer's backend.
+     */
+    void setShader(const Ref<Shader> &shader) {
+        if (shader == nullptr) {
+            shaderIndex = 0;
+            return;
+        }
+
+        auto it = std::find(shaders.begin(), shaders.end(), shader);
+        if (it == shaders.end()) {
+            if (shaders.size() > UINT8_MAX) {
+                AV_CORE_ERROR("Too many shaders used by the renderer, keeping the current one.");
+                return;
+            }
+            it = shaders.insert(shaders.end(), shader);
+        }
 
-        float zIndex = position.z;
+        shaderIndex = static_cast<uint8_t>(it - shaders.begin());
+    }
 
-        bool added = false;
+    /**
+     * Whether shapes outside the camera view are dropped at flush, on by default.
+     */
+    void setCulling(bool enabled) {
+        culling = enabled;
     }
 
-    void flush(int screenWidth, int screenHeight, Camera &camera) {
+    const RenderStats &getStats() const {
+        return stats;
+    }
 
-        std::sort(batches.begin(), batches.end(),
-                  [](const RenderBatch &a, const RenderBatch &b) {
-                      return a.getZIndex() > b.getZIndex();
-                  });
+    void flush(int screenWidth, int screenHeight, Camera &camera) {
 
         glClearColor(clearColor.x, clearColor.y, clearColor.z, clearColor.w);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        for (auto &batch: batches) {
-            batch.start();
-            batch.render(screenWidth, screenHeight, camera);
+        stats = {};
+        stats.submitted = static_cast<uint32_t>(queue.size());
+
+        // ImGui and other code may have changed the GL state since the last frame
+        GLState::invalidate();
+        GLState::resetCounters();
+
+        // the only viewport and camera uniform update of the frame, shared by every batch
+        camera.applyViewport(screenWidth, screenHeight);
+        frameUniforms->update({camera.getProjectionMatrix(), camera.getViewMatrix(), static_cast<float>(Time::getTime()), {}});
+
+        if (culling)
+            stats.culled = queue.cull(camera.getVisibleMin(), camera.getVisibleMax());
+        stats.drawn = stats.submitted - stats.culled;
+
+        const auto &commands = queue.getCommands();
+        BlendMode currentBlend = BlendMode::Alpha;
+
+        Batch *batch = nullptr;
+        uint8_t batchShader = 0;
+        BlendMode batchBlend = BlendMode::Alpha;
+
+        for (const auto &entry: queue.sort()) {
+            const RenderCommand &command = commands[entry.index];
+
+            if (batch == nullptr || batch->isFull() || !batch->canHold(command.texture) || command.shader != batchShader || command.blend != batchBlend) {
+                if (batch != nullptr)
+                    renderBatch(*batch, batchBlend, currentBlend);
+
+                batch = acquireBatch(shaders[command.shader]);
+                batchShader = command.shader;
+                batchBlend = command.blend;
+            }
+
+            batch->addShape(command.position, command.scale, command.rotation, command.shape, command.color, command.texture, command.texCoords);
         }
-        batches.clear();
+
+        if (batch != nullptr)
+            renderBatch(*batch, batchBlend, currentBlend);
+
+        applyBlendMode(BlendMode::Alpha);
+        queue.clear();
+
+        // glyphs drawn this frame are on screen, their atlas cells may be reused
+        Font::nextFrame();
+
+        stats.stateCalls = GLState::getCounters().issued;
+        stats.stateElided = GLState::getCounters().elided;
+
+        // batches and their GL buffers are kept for the next frame, only the ones left unused for a while are released
+        for (auto &x: batches)
+            x->clear();
+
+        std::erase_if(batches, [](const Scope<Batch> &x) { return x->getIdleFrames() > MaxIdleFrames; });
+
+        // hand out the batches used recently first, so the others keep aging until they are released
+        freeBatches.clear();
+        for (auto &x: batches)
+            freeBatches.push_back(x.get());
+
+        std::sort(freeBatches.begin(), freeBatches.end(), [](const Batch *a, const Batch *b) {
+            return a->getIdleFrames() > b->getIdleFrames();
+        });
 
         GLenum err;
         if ((err = glGetError()) != GL_NO_ERROR) {
@@ -81,6 +248,15 @@ public:
         }
     }
 
+    /**
+     * Sets the options of GL initialization. Only has an effect before the first Renderer is created.
+     */
+    static void configure(const RendererConfig &rendererConfig) {
+        if (initialized)
+            AV_CORE_WARN("Renderer already initialized, configuration ignored.");
+        config = rendererConfig;
+    }
+
     void static init() {
 
         if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
@@ -92,28 +268,106 @@ public:
         glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &textureUnits);
         AV_CORE_INFO("Texture units available on hardware: {0}.", textureUnits);
 
+        GLExtensions::load();
+
+        // shaders are sized to the texture slots, this must happen before the bundle compiles them
+        bool bindless = config.bindlessTextures && GLExtensions::hasBindlessTexture;
+        if (config.bindlessTextures && !bindless)
+            AV_CORE_INFO("Bindless textures requested but not supported, using texture units.");
+
+        uint32_t textureSlots = bindless ? Batch::BindlessTextureSlots : static_cast<uint32_t>(std::min(textureUnits, 256));
+        Batch::setTextureSlots(textureSlots, bindless);
+
+        Shader::define("MAX_TEXTURE_SLOTS", std::to_string(textureSlots));
+        Shader::define("FRAME_BINDING", std::to_string(FrameBinding));
+        if (bindless)
+            Shader::define("BINDLESS_TEXTURES", "1");
+
+        AV_CORE_INFO("Textures per batch: {0}{1}.", Batch::getTextureCapacity(), bindless ? " (bindless)" : "");
+
+        frameUniforms = CreateScope<UniformBuffer<FrameUniforms>>(FrameBinding);
+
         glDisable(GL_DEPTH_TEST);
         // enable transparency
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        GLState::setBlend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
         // Enable Anti-Aliasing - todo: implement with framebuffer - also check window class when removing this, line 40
         glEnable(GL_MULTISAMPLE);
 
-        // Initialize FreeType
-        FT_Library ft;
-        if (FT_Init_FreeType(&ft)) {
-            std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
-            return;
-        }
-
         AssetPool::loadBundle("resources");
     }
 
 private:
+    static constexpr uint32_t MaxIdleFrames = 120;
+    static constexpr GLuint FrameBinding = 0; // uniform buffer binding of the Frame block
+
+    inline static Scope<UniformBuffer<FrameUniforms>> frameUniforms;
+    inline static RendererConfig config;
+
+    void renderBatch(Batch &batch, BlendMode blend, BlendMode &currentBlend) {
+        if (blend != currentBlend) {
+            applyBlendMode(blend);
+            currentBlend = blend;
+        }
+
+        batch.render();
+        stats.drawCalls++;
+    }
+
+    static void applyBlendMode(BlendMode mode) {
+        switch (mode) {
+            case BlendMode::Opaque:
+                GLState::setBlend(false);
+                break;
+            case BlendMode::Additive:
+                GLState::setBlend(true, GL_SRC_ALPHA, GL_ONE);
+                break;
+            case BlendMode::Multiply:
+                GLState::setBlend(true, GL_DST_COLOR, GL_ZERO);
+                break;
+            default:
+                GLState::setBlend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                break;
+        }
+    }
+
+    Batch *acquireBatch(const Ref<Shader> &shader) {
+        Batch *batch;
+        if (freeBatches.empty()) {
+            batches.push_back(createBatch());
+            batch = batches.back().get();
+        } else {
+            batch = freeBatches.back();
+            freeBatches.pop_back();
+        }
+
+        batch->setShader(shader);
+        return batch;
+    }
+
+    Scope<Batch> createBatch() const {
+        if (backend == RenderBackend::Instanced)
+            return CreateScope<InstanceBatch>(maxBatchSize, shaders[0]);
+
+        return CreateScope<RenderBatch>(maxBatchSize, shaders[0]);
+    }
+
     int32_t maxBatchSize = 0;
-    std::vector<RenderBatch> batches;
+    RenderBackend backend = RenderBackend::Vertices;
     glm::vec4 clearColor{1.0f, 1.0f, 1.0f, 1.0f};
 
+    RenderQueue queue;
+    RenderStats stats;
+    bool culling = true;
+
+    // draw state applied to the next shapes
+    uint8_t layer = 0;
+    uint8_t shaderIndex = 0;
+    BlendMode blendMode = BlendMode::Alpha;
+    std::vector<Ref<Shader>> shaders; // indexed by the shader field of the sort key
+
+    std::vector<Scope<Batch>> batches;
+    std::vector<Batch *> freeBatches; // cleared batches not used yet this frame, most idle first
+
     inline static bool initialized = false;
 };
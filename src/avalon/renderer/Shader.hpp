@@ -1,16 +1,103 @@
 #pragma once
 
 #include "avalon/core/Core.hpp"
+#include "GLExtensions.hpp"
+#include "GLState.hpp"
+#include "ShaderCache.hpp"
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <map>
+#include <numeric>
+#include <string_view>
+
+/**
+ * Location of a uniform in a linked program, written with glProgramUniform* so neither a lookup nor
+ * a bound program is needed. A default handle refers to no uniform and ignores writes without calling
+ * GL, since glProgramUniform* on program 0 is an error where glUniform* on location -1 is not.
+ */
+class UniformHandle {
+public:
+    UniformHandle() = default;
+
+    UniformHandle(GLuint program, GLint location) : program(program), location(location) {}
+
+    bool isValid() const {
+        return program != 0 && location >= 0;
+    }
+
+    void set(int value) const {
+        if (isValid())
+            glProgramUniform1i(program, location, value);
+    }
+
+    void set(float value) const {
+        if (isValid())
+            glProgramUniform1f(program, location, value);
+    }
+
+    void set(const glm::vec2 &vec) const {
+        if (isValid())
+            glProgramUniform2f(program, location, vec.x, vec.y);
+    }
+
+    void set(const glm::vec3 &vec) const {
+        if (isValid())
+            glProgramUniform3f(program, location, vec.x, vec.y, vec.z);
+    }
+
+    void set(const glm::vec4 &vec) const {
+        if (isValid())
+            glProgramUniform4f(program, location, vec.x, vec.y, vec.z, vec.w);
+    }
+
+    void set(const glm::mat3 &mat) const {
+        if (isValid())
+            glProgramUniformMatrix3fv(program, location, 1, GL_FALSE, glm::value_ptr(mat));
+    }
+
+    void set(const glm::mat4 &mat) const {
+        if (isValid())
+            glProgramUniformMatrix4fv(program, location, 1, GL_FALSE, glm::value_ptr(mat));
+    }
+
+    void set(const int *array, int size) const {
+        if (isValid())
+            glProgramUniform1iv(program, location, size, array);
+    }
+
+    // bindless texture handles, see GLExtensions::hasBindlessTexture
+    void set(const GLuint64 *handles, int size) const {
+        if (isValid())
+            GLExtensions::programUniformHandleui64v(program, location, size, handles);
+    }
+
+private:
+    GLuint program = 0;
+    GLint location = -1;
+};
+
 
 class Shader {
 private:
     unsigned int shaderID = 0, vertexShaderID = 0, fragmentShaderID = 0;
-    bool isBeingUsed = false;
+    bool loadedFromCache = false;
+    bool pending = false; // compiled and linked, statuses not checked yet
+    // built with BINDLESS_TEXTURES: sampler arrays hold texture handles written by Batch, not units
+    bool bindlessSamplers = defines.contains("BINDLESS_TEXTURES");
+    uint64_t cacheKey = 0;
+
+    // active uniforms of the linked program, arrays under their name without [0]
+    struct Uniform {
+        std::string name;
+        GLint location;
+        GLenum type;
+        GLint size; // elements of an array, 1 otherwise
+    };
+
+    std::vector<Uniform> uniforms;
 
     std::string filePath;
 
@@ -45,7 +132,7 @@ public:
             size_t fragmentEnd = content.find('\n', fragmentPos) + 1;
             fragmentSource = content.substr(fragmentEnd);
 
-            loadAndCompile(vertexSource.c_str(), fragmentSource.c_str());
+            loadAndCompile(specialize(vertexSource), specialize(fragmentSource));
 
         } catch (const std::exception &e) {
             AV_CORE_ERROR(e.what());
@@ -54,7 +141,15 @@ public:
     }
 
     Shader(const std::string &vertexShaderString, const std::string &fragmentShaderString) {
-        loadAndCompile(vertexShaderString.c_str(), fragmentShaderString.c_str());
+        loadAndCompile(specialize(vertexShaderString), specialize(fragmentShaderString));
+    }
+
+    /**
+     * Adds `#define name value` to every shader compiled afterwards, right after its #version line.
+     * Used to size shaders to the hardware, e.g. MAX_TEXTURE_SLOTS.
+     */
+    static void define(const std::string &name, const std::string &value) {
+        defines[name] = value;
     }
 
     ~Shader() {
@@ -63,11 +158,49 @@ public:
 
 private:
 
-    void loadAndCompile(const char *vertexSource, const char *fragmentSource) {
+    static std::string specialize(const std::string &source) {
+        if (defines.empty())
+            return source;
+
+        std::string block;
+        for (const auto &[name, value]: defines)
+            block += "#define " + name + " " + value + "\n";
+
+        // #version must stay the first statement
+        size_t insertAt = 0;
+        size_t version = source.find("#version");
+        if (version != std::string::npos) {
+            size_t lineEnd = source.find('\n', version);
+            insertAt = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+        }
+
+        std::string result = source;
+        if (insertAt == result.size() && !result.empty() && result.back() != '\n') {
+            result += '\n';
+            insertAt = result.size();
+        }
+
+        return result.insert(insertAt, block);
+    }
+
+    inline static std::map<std::string, std::string> defines;
+
+    void loadAndCompile(const std::string &vertexString, const std::string &fragmentString) {
 
         // create a shader program
         shaderID = glCreateProgram();
 
+        // a program linked on a previous run with the same sources and driver skips compilation
+        cacheKey = ShaderCache::key(vertexString, fragmentString);
+        if (ShaderCache::load(shaderID, cacheKey)) {
+            loadedFromCache = true;
+            reflectUniforms();
+            return;
+        }
+
+        const char *vertexSource = vertexString.c_str();
+        const char *fragmentSource = fragmentString.c_str();
+
         // vertex Shader
         this->vertexShaderID = glCreateShader(GL_VERTEX_SHADER);
 
@@ -75,19 +208,6 @@ private:
         glShaderSource(this->vertexShaderID, 1, &vertexSource, nullptr);
         glCompileShader(vertexShaderID);
 
-        int success;
-        glGetShaderiv(vertexShaderID, GL_COMPILE_STATUS, &success);
-
-        // check for errors
-        if (success == GL_FALSE) {
-            int len;
-            glGetShaderiv(vertexShaderID, GL_INFO_LOG_LENGTH, &len);
-            std::string message(len, ' ');
-            glGetShaderInfoLog(vertexShaderID, len, nullptr, &(message[0]));
-
-            AV_CORE_ERROR("ERROR: Vertex shader compilation failed: {0}", message);
-        }
-
         // fragment Shader
         this->fragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
 
@@ -95,111 +215,237 @@ private:
         glShaderSource(this->fragmentShaderID, 1, &fragmentSource, nullptr);
         glCompileShader(fragmentShaderID);
 
-        glGetShaderiv(fragmentShaderID, GL_COMPILE_STATUS, &success);
+        // attach shaders to the program and link without waiting for the compiler, statuses are
+        // checked in finish() so that the driver can work on several programs at once
+        glAttachShader(shaderID, vertexShaderID);
+        glAttachShader(shaderID, fragmentShaderID);
+        glProgramParameteri(shaderID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(shaderID);
+
+        pending = true;
+    }
+
+    static void checkCompileStatus(GLuint shader, const char *stage) {
+        int success;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
 
         // check for errors
         if (success == GL_FALSE) {
             int len;
-            glGetShaderiv(fragmentShaderID, GL_INFO_LOG_LENGTH, &len);
+            glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len);
             std::string message(len, ' ');
-            glGetShaderInfoLog(fragmentShaderID, len, nullptr, &(message[0]));
+            glGetShaderInfoLog(shader, len, nullptr, &(message[0]));
 
-            AV_CORE_ERROR("ERROR: Fragment shader compilation failed: {0}", message);
+            AV_CORE_ERROR("ERROR: {0} shader compilation failed: {1}", stage, message);
         }
+    }
 
-        // attach shaders to the program
-        glAttachShader(shaderID, vertexShaderID);
-        glAttachShader(shaderID, fragmentShaderID);
-        glLinkProgram(shaderID);
+    void reflectUniforms() {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(shaderID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(shaderID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::string name(maxLength, '\0');
+        for (GLint i = 0; i < count; i++) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(shaderID, i, maxLength, &length, &size, &type, name.data());
+
+            std::string uniformName = name.substr(0, length);
+            if (uniformName.ends_with("[0]"))
+                uniformName.resize(uniformName.size() - 3);
+
+            // members of uniform blocks have no location
+            GLint location = glGetUniformLocation(shaderID, uniformName.c_str());
+            if (location >= 0)
+                uniforms.push_back({std::move(uniformName), location, type, size});
+        }
+
+        // samplers read consecutive texture units, set once here instead of before every draw
+        static GLint maxUnits = 0;
+        if (maxUnits == 0)
+            glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &maxUnits);
+
+        GLint unit = 0;
+        for (const auto &uniform: uniforms) {
+            if (!isSampler(uniform.type) || (bindlessSamplers && uniform.size > 1))
+                continue;
+
+            if (unit + uniform.size > maxUnits) {
+                AV_CORE_WARN("Shader {0} has more samplers than the {1} texture units.", filePath, maxUnits);
+                break;
+            }
+
+            std::vector<GLint> units(uniform.size);
+            std::iota(units.begin(), units.end(), unit);
+            glProgramUniform1iv(shaderID, uniform.location, uniform.size, units.data());
+            unit += uniform.size;
+        }
+    }
+
+    static bool isSampler(GLenum type) {
+        switch (type) {
+            case GL_SAMPLER_1D:
+            case GL_SAMPLER_2D:
+            case GL_SAMPLER_3D:
+            case GL_SAMPLER_CUBE:
+            case GL_SAMPLER_2D_ARRAY:
+            case GL_SAMPLER_2D_SHADOW:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+
+public:
+
+    const std::string &getFilePath() const {
+        return filePath;
+    }
+
+    /**
+     * Whether the program was linked from the ShaderCache rather than compiled.
+     */
+    bool isFromCache() const {
+        return loadedFromCache;
+    }
+
+    /**
+     * Waits for the compilation and link submitted by loadAndCompile, reports their errors and
+     * prepares the program for use. Called on first use if nobody called it before.
+     */
+    void finish() {
+        if (!pending)
+            return;
+
+        pending = false;
+
+        checkCompileStatus(vertexShaderID, "Vertex");
+        checkCompileStatus(fragmentShaderID, "Fragment");
 
         // check for linking errors
+        int success;
         glGetProgramiv(shaderID, GL_LINK_STATUS, &success);
 
         if (success == GL_FALSE) {
             char log[1024];
             glGetProgramInfoLog(shaderID, 1024, nullptr, log);
             std::cout << "ERROR: Shader program linking failed: " << log << "\n";
+        } else {
+            ShaderCache::store(shaderID, cacheKey);
         }
 
         // clean up shaders (no longer needed once linked)
         glDeleteShader(vertexShaderID);
         glDeleteShader(fragmentShaderID);
+        vertexShaderID = fragmentShaderID = 0;
+
+        reflectUniforms();
     }
 
+    /**
+     * Whether the program can be used without waiting for the driver. Without
+     * GLExtensions::hasParallelShaderCompile this cannot be known and only becomes true once used.
+     */
+    bool isReady() const {
+        if (!pending)
+            return true;
 
-public:
+        if (!GLExtensions::hasParallelShaderCompile)
+            return false;
 
-    const std::string &getFilePath() const {
-        return filePath;
+        GLint done = GL_FALSE;
+        glGetProgramiv(shaderID, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
     }
 
+    // the program in use is tracked by GLState, binding the current program again costs nothing
     void bind() {
-        if (!isBeingUsed) {
-            glUseProgram(shaderID);
-            isBeingUsed = true;
-        }
+        finish();
+        GLState::useProgram(shaderID);
     }
 
     void unbind() {
-        glUseProgram(0);
-        isBeingUsed = false;
+        GLState::useProgram(0);
     }
 
     void remove() {
-        unbind();
+        if (pending) {
+            glDeleteShader(vertexShaderID);
+            glDeleteShader(fragmentShaderID);
+        }
+
+        GLState::onDeleteProgram(shaderID);
         glDeleteProgram(shaderID);
     }
 
+    /**
+     * Handle of an active uniform, or of one element with "name[i]". Looked up in the table built at
+     * link time, waiting for the link if needed; keep the handle rather than calling this every frame.
+     * Unknown or optimized out uniforms give an invalid handle.
+     */
+    UniformHandle getUniform(std::string_view name) {
+        finish();
+
+        GLint element = 0;
+        if (name.ends_with(']')) {
+            std::size_t open = name.rfind('[');
+            if (open == std::string_view::npos)
+                return {};
+
+            element = std::atoi(std::string(name.substr(open + 1)).c_str());
+            name = name.substr(0, open);
+        }
+
+        for (const auto &uniform: uniforms) {
+            if (uniform.name == name)
+                return element < uniform.size ? UniformHandle(shaderID, uniform.location + element) : UniformHandle();
+        }
+
+        return {};
+    }
+
     void uploadMat4f(const std::string &varName, const glm::mat4 &mat) {
-        int varLocation = glGetUniformLocation(shaderID, &(varName[0]));
-        bind();
-        glUniformMatrix4fv(varLocation, 1, GL_FALSE, glm::value_ptr(mat));
+        getUniform(varName).set(mat);
     }
 
     void uploadMat3f(const std::string &varName, const glm::mat3 &mat) {
-        int varLocation = glGetUniformLocation(shaderID, &(varName[0]));
-        bind();
-        glUniformMatrix3fv(varLocation, 1, GL_FALSE, glm::value_ptr(mat));
+        getUniform(varName).set(mat);
     }
 
     void uploadVec4f(const std::string &varName, const glm::vec4 &vec) {
-        int varLocation = glGetUniformLocation(shaderID, &(varName[0]));
-        bind();
-        glUniform4f(varLocation, vec.x, vec.y, vec.z, vec.w);
+        getUniform(varName).set(vec);
     }
 
     void uploadVec3f(const std::string &varName, const glm::vec3 &vec) {
-        int varLocation = glGetUniformLocation(shaderID, &(varName[0]));
-        bind();
-        glUniform3f(varLocation, vec.x, vec.y, vec.z);
+        getUniform(varName).set(vec);
     }
 
     void uploadVec2f(const std::string &varName, const glm::vec2 &vec) {
-        int varLocation = glGetUniformLocation(shaderID, &(varName[0]));
-        bind();
-        glUniform2f(varLocation, vec.x, vec.y);
+        getUniform(varName).set(vec);
     }
 
 
     void uploadFloat(const std::string &varName, float value) {
-        int varLocation = glGetUniformLocation(shaderID, &(varName[0]));
-        bind();
-        glUniform1f(varLocation, value);
+        getUniform(varName).set(value);
     }
 
     void uploadInt(const std::string &varName, int value) {
-        int varLocation = glGetUniformLocation(shaderID, &(varName[0]));
-        bind();
-        glUniform1i(varLocation, value);
+        getUniform(varName).set(value);
     }
 
     void uploadTexture(const std::string &varName, int slot) {
         uploadInt(varName, slot);
     }
 
-    void uploadIntArray(std::string varName, int array[], int size) {
-        int varLocation = glGetUniformLocation(shaderID, &(varName[0]));
-        bind();
-        glUniform1iv(varLocation, size, array);
+    void uploadIntArray(const std::string &varName, const int *array, int size) {
+        getUniform(varName).set(array, size);
+    }
+
+    // bindless texture handles, see GLExtensions::hasBindlessTexture
+    void uploadHandleArray(const std::string &varName, const GLuint64 *handles, int size) {
+        getUniform(varName).set(handles, size);
     }
 };
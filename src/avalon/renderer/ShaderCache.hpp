@@ -0,0 +1,137 @@
+#pragma once
+
+#include "avalon/core/Core.hpp"
+
+#include <glad/glad.h>
+
+#include <iomanip>
+
+/**
+ * Disk cache of linked program binaries (glGetProgramBinary), so later runs skip compiling and
+ * linking. An entry is keyed by the FNV-1a hash of the driver's vendor, renderer and version strings
+ * and of the final sources, so a driver update or an edited shader simply misses. A binary the driver
+ * rejects anyway is reported as a miss and replaced after the source compile.
+ */
+class ShaderCache {
+public:
+
+    static void setDirectory(const std::string &path) {
+        directory = path;
+    }
+
+    /**
+     * Whether the driver can save programs at all, false until a context exists.
+     */
+    static bool isEnabled() {
+        if (binaryFormats < 0) {
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+            if (binaryFormats == 0)
+                AV_CORE_INFO("Driver has no program binary format, shaders are compiled on every run.");
+        }
+        return binaryFormats > 0;
+    }
+
+    static uint64_t key(const std::string &vertexSource, const std::string &fragmentSource) {
+        // the driver does not change while running, its strings are hashed once
+        if (driverHash == 0) {
+            driverHash = FnvOffset;
+            for (GLenum name: {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+                auto value = reinterpret_cast<const char *>(glGetString(name));
+                driverHash = fnv1a(driverHash, value ? value : "");
+                driverHash = fnv1a(driverHash, std::string_view("\0", 1));
+            }
+        }
+
+        // the separator keeps "ab" + "c" apart from "a" + "bc"
+        uint64_t hash = fnv1a(driverHash, vertexSource);
+        hash = fnv1a(hash, std::string_view("\0", 1));
+        return fnv1a(hash, fragmentSource);
+    }
+
+    /**
+     * Links `program` from its cached binary, false if there is none or the driver refused it.
+     */
+    static bool load(GLuint program, uint64_t key) {
+        if (!isEnabled())
+            return false;
+
+        std::string path = pathOf(key);
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+            return false;
+
+        Header header{};
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if (!file || header.magic != Magic || header.length != std::filesystem::file_size(path) - sizeof(header))
+            return false;
+
+        std::vector<char> binary(header.length);
+        file.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+        if (!file)
+            return false;
+
+        glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+        GLint success = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        return success == GL_TRUE;
+    }
+
+    /**
+     * Saves a linked program. It should have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT.
+     */
+    static void store(GLuint program, uint64_t key) {
+        if (!isEnabled())
+            return;
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+
+        Header header{Magic, 0, static_cast<uint32_t>(length)};
+        std::vector<char> binary(length);
+        glGetProgramBinary(program, length, nullptr, &header.format, binary.data());
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+
+        std::ofstream file(pathOf(key), std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            AV_CORE_WARN("Could not write shader cache entry {0}.", pathOf(key));
+            return;
+        }
+
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(binary.data(), length);
+    }
+
+private:
+    static constexpr uint64_t FnvOffset = 14695981039346656037ull;
+    static constexpr uint64_t FnvPrime = 1099511628211ull;
+    static constexpr uint32_t Magic = 0x42535641; // "AVSB"
+
+    struct Header {
+        uint32_t magic;
+        GLenum format;
+        uint32_t length;
+    };
+
+    static uint64_t fnv1a(uint64_t hash, std::string_view data) {
+        for (char c: data) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= FnvPrime;
+        }
+        return hash;
+    }
+
+    static std::string pathOf(uint64_t key) {
+        std::stringstream path;
+        path << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+        return path.str();
+    }
+
+    inline static std::string directory = "cache/shaders";
+    inline static GLint binaryFormats = -1;
+    inline static uint64_t driverHash = 0;
+};
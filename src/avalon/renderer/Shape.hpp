@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+enum Shape : uint32_t {
+    QUAD,
+    CIRCLE,
+    TEXT,
+    SDF_TEXT // glyph alpha is a distance to the outline, see Font
+};
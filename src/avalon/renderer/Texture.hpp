@@ -1,6 +1,8 @@
 #pragma once
 
 #include "avalon/core/Core.hpp"
+#include "GLExtensions.hpp"
+#include "GLState.hpp"
 #include <glad/glad.h>
 
 #include "stb_image.h"
@@ -8,6 +10,7 @@
 class Texture {
 private:
     GLuint textureID;
+    GLuint64 handle = 0;
     int width, height, channel;
 
     std::string filePath;
@@ -17,13 +20,37 @@ public:
         generateAndLoad(filePath.c_str());
     }
 
+    /**
+     * Texture from RGBA8 pixels in memory (rows top to bottom), e.g. an atlas page. It is clamped to
+     * its edges instead of repeating; `name` is returned by getFilePath.
+     */
+    Texture(std::string name, int width, int height, const uint8_t *pixels, GLint filter = GL_NEAREST) : width(width), height(height), channel(4), filePath(std::move(name)) {
+        glGenTextures(1, &textureID);
+        GLState::selectTexture(0, textureID);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    }
+
+    /**
+     * Replaces a rectangle of an RGBA8 texture with pixels in memory (rows top to bottom).
+     */
+    void setPixels(int x, int y, int regionWidth, int regionHeight, const uint8_t *pixels) {
+        GLState::selectTexture(0, textureID);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, regionWidth, regionHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    }
+
 private:
 
 
     void generateAndLoad(const char *filePath) {
 
         glGenTextures(1, &textureID);
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        GLState::selectTexture(0, textureID);
 
         // Set the texture parameters
         // Repeat the image in both directions
@@ -57,12 +84,28 @@ private:
     }
 
 public:
-    void bind() const {
-        glBindTexture(GL_TEXTURE_2D, textureID);
+    void bind(uint32_t unit = 0) const {
+        GLState::bindTexture(unit, textureID);
+    }
+
+    void unbind(uint32_t unit = 0) const {
+        GLState::bindTexture(unit, 0);
     }
 
-    void unbind() {
-        glBindTexture(GL_TEXTURE_2D, 0);
+    GLuint getID() const {
+        return textureID;
+    }
+
+    /**
+     * Bindless handle of the texture, made resident on first use. Requires GLExtensions::hasBindlessTexture,
+     * and the texture parameters can no longer change afterwards.
+     */
+    GLuint64 getHandle() {
+        if (handle == 0) {
+            handle = GLExtensions::getTextureHandle(textureID);
+            GLExtensions::makeTextureHandleResident(handle);
+        }
+        return handle;
     }
 
     const std::string &getFilePath() const {
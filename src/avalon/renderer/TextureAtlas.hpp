@@ -0,0 +1,186 @@
+#pragma once
+
+#include "Texture.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <numeric>
+
+/**
+ * Packs RGBA8 images into square pages with a skyline bottom-left packer. Every image is surrounded by
+ * `padding` pixels repeating its border (extrusion), so filtering and rounding at the edges of a
+ * region never read a neighbouring image.
+ *
+ * TextureAtlas atlas(2048);
+ * auto regions = atlas.pack(images);
+ * auto pages = atlas.createTextures("atlas");
+ */
+class TextureAtlas {
+public:
+    struct Image {
+        int width = 0;
+        int height = 0;
+        const uint8_t *pixels = nullptr; // RGBA8, rows top to bottom
+    };
+
+    struct Region {
+        uint32_t page = 0;
+        glm::ivec2 position{0}; // top-left pixel of the image in the page, padding excluded
+        glm::ivec2 size{0};
+    };
+
+    explicit TextureAtlas(int pageSize, int padding = 2) : pageSize(pageSize), padding(padding) {}
+
+    /**
+     * Whether an image of this size fits in a page with its padding.
+     */
+    bool fits(int width, int height) const {
+        return width + 2 * padding <= pageSize && height + 2 * padding <= pageSize;
+    }
+
+    /**
+     * Places and copies the images, opening pages as needed. Returns one region per image, in the same
+     * order. Every image must fit in a page.
+     */
+    std::vector<Region> pack(const std::vector<Image> &images) {
+        // taller images first keeps the skyline flat
+        std::vector<uint32_t> order(images.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&images](uint32_t a, uint32_t b) {
+            return images[a].height > images[b].height;
+        });
+
+        std::vector<Region> regions(images.size());
+        for (uint32_t i: order) {
+            const Image &image = images[i];
+            glm::ivec2 padded{image.width + 2 * padding, image.height + 2 * padding};
+
+            uint32_t page = 0;
+            glm::ivec2 position;
+            while (page < pages.size() && !pages[page].insert(padded, pageSize, position))
+                page++;
+
+            if (page == pages.size()) {
+                pages.emplace_back(pageSize);
+                pages.back().insert(padded, pageSize, position);
+            }
+
+            regions[i] = {page, position + padding, {image.width, image.height}};
+            blit(pages[page].pixels, image, regions[i].position);
+        }
+
+        return regions;
+    }
+
+    /**
+     * Uploads every page as a texture named `name#<page>`.
+     */
+    std::vector<Ref<Texture>> createTextures(const std::string &name) const {
+        std::vector<Ref<Texture>> textures;
+        for (std::size_t i = 0; i < pages.size(); i++)
+            textures.push_back(CreateRef<Texture>(name + "#" + std::to_string(i), pageSize, pageSize, pages[i].pixels.data()));
+        return textures;
+    }
+
+    /**
+     * Maps texture coordinates of an image to coordinates of its page.
+     */
+    glm::vec2 toPage(const Region &region, const glm::vec2 &texCoords) const {
+        return (glm::vec2(region.position) + texCoords * glm::vec2(region.size)) / static_cast<float>(pageSize);
+    }
+
+    std::size_t getPageCount() const {
+        return pages.size();
+    }
+
+private:
+    struct Page {
+        explicit Page(int size) : pixels(static_cast<std::size_t>(size) * size * 4, 0), skyline{{0, 0, size}} {}
+
+        // bottom-left: lowest top edge, then leftmost
+        bool insert(const glm::ivec2 &size, int pageSize, glm::ivec2 &position) {
+            int bestY = INT_MAX, bestIndex = -1;
+
+            for (int i = 0; i < static_cast<int>(skyline.size()); i++) {
+                int x = skyline[i].x;
+                if (x + size.x > pageSize)
+                    break;
+
+                // the rectangle rests on the highest segment below it
+                int y = 0, covered = 0;
+                for (int j = i; covered < size.x; j++) {
+                    y = std::max(y, skyline[j].y);
+                    covered += skyline[j].width;
+                }
+
+                if (y + size.y <= pageSize && y < bestY) {
+                    bestY = y;
+                    bestIndex = i;
+                }
+            }
+
+            if (bestIndex < 0)
+                return false;
+
+            position = {skyline[bestIndex].x, bestY};
+            place(bestIndex, position, size);
+            return true;
+        }
+
+        void place(int index, const glm::ivec2 &position, const glm::ivec2 &size) {
+            skyline.insert(skyline.begin() + index, {position.x, position.y + size.y, size.x});
+
+            // shrink or remove the segments now below the new one
+            int right = position.x + size.x;
+            for (std::size_t i = index + 1; i < skyline.size();) {
+                Segment &segment = skyline[i];
+                if (segment.x >= right)
+                    break;
+
+                int overlap = right - segment.x;
+                if (overlap < segment.width) {
+                    segment.x += overlap;
+                    segment.width -= overlap;
+                    break;
+                }
+                skyline.erase(skyline.begin() + i);
+            }
+
+            // merge neighbours of equal height
+            for (std::size_t i = 0; i + 1 < skyline.size();) {
+                if (skyline[i].y == skyline[i + 1].y) {
+                    skyline[i].width += skyline[i + 1].width;
+                    skyline.erase(skyline.begin() + i + 1);
+                } else {
+                    i++;
+                }
+            }
+        }
+
+        struct Segment {
+            int x, y, width;
+        };
+
+        std::vector<uint8_t> pixels;
+        std::vector<Segment> skyline; // top edge of the packed area, left to right
+    };
+
+    // copies the image and extrudes its border into the padding
+    void blit(std::vector<uint8_t> &page, const Image &image, const glm::ivec2 &position) const {
+        for (int y = -padding; y < image.height + padding; y++) {
+            int sourceY = std::clamp(y, 0, image.height - 1);
+
+            for (int x = -padding; x < image.width + padding; x++) {
+                int sourceX = std::clamp(x, 0, image.width - 1);
+
+                const uint8_t *source = image.pixels + (static_cast<std::size_t>(sourceY) * image.width + sourceX) * 4;
+                uint8_t *destination = page.data() + (static_cast<std::size_t>(position.y + y) * pageSize + position.x + x) * 4;
+                std::memcpy(destination, source, 4);
+            }
+        }
+    }
+
+    int pageSize;
+    int padding;
+    std::vector<Page> pages;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "avalon/core/Core.hpp"
+#include "GLState.hpp"
+
+#include <glad/glad.h>
+
+/**
+ * Uniform buffer attached to a fixed binding point, shared by every program declaring a block with
+ * the same binding. T must match the std140 layout of the block.
+ */
+template<typename T>
+class UniformBuffer {
+public:
+    explicit UniformBuffer(GLuint binding) : binding(binding) {
+        glGenBuffers(1, &UBO);
+        GLState::bindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+
+        // also binds the generic target, which already holds UBO
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, UBO);
+    }
+
+    ~UniformBuffer() {
+        GLState::onDeleteBuffer(UBO);
+        if (UBO) glDeleteBuffers(1, &UBO);
+    }
+
+    // owns a GL buffer
+    UniformBuffer(const UniformBuffer &) = delete;
+
+    UniformBuffer &operator=(const UniformBuffer &) = delete;
+
+    void update(const T &data) {
+        GLState::bindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+    }
+
+    GLuint getBinding() const {
+        return binding;
+    }
+
+private:
+    GLuint UBO = 0;
+    GLuint binding;
+};
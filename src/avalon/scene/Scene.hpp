@@ -1,8 +1,9 @@
 #pragma once
 
-#include "avalon/entity/Registry.hpp"
+#include "avalon/entity/SystemScheduler.hpp"
 #include "avalon/renderer/Renderer.hpp"
 #include "Layer.hpp"
+#include "SpatialIndex.hpp"
 
 #include <GLFW/glfw3.h>
 
@@ -28,6 +29,8 @@ protected:
 
     LayerStack layers;
     Registry registry;
+    SpatialIndex spatialIndex{registry}; // declared after the registry it observes
+    SystemScheduler systems;
     ResourceBundle *resourceBundle;
 
     friend class ImGuiLayer;
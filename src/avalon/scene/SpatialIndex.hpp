@@ -0,0 +1,229 @@
+#pragma once
+
+#include "avalon/entity/Registry.hpp"
+#include "avalon/components/RenderComponent.hpp"
+
+/**
+ * Spatial hash over the bounds (position +- scale / 2) of every RenderComponent. Rectangle and point
+ * queries visit only the grid cells they cover, so their cost follows what is inside the rectangle
+ * rather than the size of the world.
+ *
+ * The index observes the RenderComponent pool and follows Registry::addComponent, removeComponent,
+ * patch and markChanged. A component mutated in place must be marked changed to move in the index.
+ *
+ * spatialIndex.query(camera.getVisibleMin(), camera.getVisibleMax(), [&](ActorId id) { ... });
+ */
+class SpatialIndex : public ComponentObserver {
+public:
+    // actors covering more cells than this are kept in a list tested by every query
+    static constexpr int MaxCellsPerActor = 64;
+
+    explicit SpatialIndex(Registry &registry, float cellSize = 128.0f) : registry(registry), cellSize(cellSize) {
+        registry.observe<RenderComponent>(*this);
+
+        // index the components added before the index existed
+        auto &pool = registry.getPool<RenderComponent>();
+        for (auto id: pool.getActors())
+            update(id);
+    }
+
+    ~SpatialIndex() override {
+        registry.unobserve<RenderComponent>(*this);
+    }
+
+    SpatialIndex(const SpatialIndex &) = delete;
+
+    SpatialIndex &operator=(const SpatialIndex &) = delete;
+
+    void onConstruct(ActorId id) override {
+        update(id);
+    }
+
+    void onUpdate(ActorId id) override {
+        update(id);
+    }
+
+    void onDestroy(ActorId id) override {
+        uint32_t index = actorIndex(id);
+        if (index < entries.size() && entries[index].id == id) {
+            unlink(entries[index]);
+            entries[index] = {};
+            count--;
+        }
+    }
+
+    /**
+     * Calls func(ActorId) once for every actor whose bounds overlap the rectangle.
+     */
+    template<typename Func>
+    void query(const glm::vec2 &min, const glm::vec2 &max, Func func) const {
+        glm::ivec2 from = cellOf(min), to = cellOf(max);
+
+        // an actor spanning several cells is reported by the first of them inside the query
+        auto visit = [&](int x, int y, const std::vector<ActorId> &actors) {
+            for (auto id: actors) {
+                const Entry &entry = entries[actorIndex(id)];
+                if (overlaps(entry, min, max) && x == std::max(entry.cellMin.x, from.x) && y == std::max(entry.cellMin.y, from.y))
+                    func(id);
+            }
+        };
+
+        auto area = static_cast<int64_t>(to.x - from.x + 1) * (to.y - from.y + 1);
+        if (area > static_cast<int64_t>(cells.size())) {
+            // wider than the populated world, walk the occupied cells instead
+            for (const auto &[key, actors]: cells) {
+                int x = static_cast<int32_t>(key >> 32), y = static_cast<int32_t>(key & 0xFFFFFFFFu);
+                if (x >= from.x && x <= to.x && y >= from.y && y <= to.y)
+                    visit(x, y, actors);
+            }
+        } else {
+            for (int y = from.y; y <= to.y; y++) {
+                for (int x = from.x; x <= to.x; x++) {
+                    auto it = cells.find(keyOf(x, y));
+                    if (it != cells.end())
+                        visit(x, y, it->second);
+                }
+            }
+        }
+
+        for (auto id: oversized) {
+            if (overlaps(entries[actorIndex(id)], min, max))
+                func(id);
+        }
+    }
+
+    /**
+     * Calls func(ActorId) for every actor whose bounds contain the point.
+     */
+    template<typename Func>
+    void query(const glm::vec2 &point, Func func) const {
+        query(point, point, func);
+    }
+
+    /**
+     * Visible actor drawn on top at the point (the Renderer draws lower z last), or NullActorId. With
+     * Camera::screenToWorld this picks the actor under the mouse.
+     */
+    ActorId pick(const glm::vec2 &point) const {
+        ActorId picked = NullActorId;
+        float pickedZ = 0.0f;
+
+        query(point, [&](ActorId id) {
+            const RenderComponent *render = registry.getComponent<RenderComponent>(id);
+            if (render && render->isVisible && (picked == NullActorId || render->position.z < pickedZ)) {
+                picked = id;
+                pickedZ = render->position.z;
+            }
+        });
+
+        return picked;
+    }
+
+    /**
+     * Number of indexed actors.
+     */
+    std::size_t size() const {
+        return count;
+    }
+
+private:
+    struct Entry {
+        ActorId id = NullActorId;
+        glm::vec2 min{0.0f}, max{0.0f};
+        glm::ivec2 cellMin{0}, cellMax{0};
+        bool large = false; // kept in `oversized` instead of the cells
+    };
+
+    void update(ActorId id) {
+        const RenderComponent *render = registry.getComponent<RenderComponent>(id);
+        if (!render)
+            return;
+
+        glm::vec2 half = 0.5f * glm::abs(render->scale);
+        glm::vec2 min = glm::vec2(render->position) - half;
+        glm::vec2 max = glm::vec2(render->position) + half;
+        glm::ivec2 cellMin = cellOf(min), cellMax = cellOf(max);
+
+        uint32_t index = actorIndex(id);
+        if (index >= entries.size())
+            entries.resize(index + 1);
+
+        Entry &entry = entries[index];
+        if (entry.id == id) {
+            // most moves stay within the same cells
+            if (entry.cellMin == cellMin && entry.cellMax == cellMax) {
+                entry.min = min;
+                entry.max = max;
+                return;
+            }
+            unlink(entry);
+        } else {
+            count++;
+        }
+
+        entry = {id, min, max, cellMin, cellMax};
+        link(entry);
+    }
+
+    void link(Entry &entry) {
+        auto area = static_cast<int64_t>(entry.cellMax.x - entry.cellMin.x + 1) * (entry.cellMax.y - entry.cellMin.y + 1);
+        entry.large = area > MaxCellsPerActor;
+
+        if (entry.large) {
+            oversized.push_back(entry.id);
+            return;
+        }
+
+        for (int y = entry.cellMin.y; y <= entry.cellMax.y; y++)
+            for (int x = entry.cellMin.x; x <= entry.cellMax.x; x++)
+                cells[keyOf(x, y)].push_back(entry.id);
+    }
+
+    void unlink(const Entry &entry) {
+        if (entry.large) {
+            std::erase(oversized, entry.id);
+            return;
+        }
+
+        for (int y = entry.cellMin.y; y <= entry.cellMax.y; y++) {
+            for (int x = entry.cellMin.x; x <= entry.cellMax.x; x++) {
+                auto it = cells.find(keyOf(x, y));
+                if (it == cells.end())
+                    continue;
+
+                auto &actors = it->second;
+                auto position = std::find(actors.begin(), actors.end(), entry.id);
+                if (position != actors.end()) {
+                    *position = actors.back();
+                    actors.pop_back();
+                }
+
+                if (actors.empty())
+                    cells.erase(it);
+            }
+        }
+    }
+
+    static bool overlaps(const Entry &entry, const glm::vec2 &min, const glm::vec2 &max) {
+        return entry.min.x <= max.x && entry.max.x >= min.x && entry.min.y <= max.y && entry.max.y >= min.y;
+    }
+
+    glm::ivec2 cellOf(const glm::vec2 &point) const {
+        // clamped so huge or infinite coordinates stay representable
+        constexpr float limit = 1 << 30;
+        return {static_cast<int>(std::clamp(std::floor(point.x / cellSize), -limit, limit)),
+                static_cast<int>(std::clamp(std::floor(point.y / cellSize), -limit, limit))};
+    }
+
+    static uint64_t keyOf(int x, int y) {
+        return static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32 | static_cast<uint32_t>(y);
+    }
+
+    Registry &registry;
+    float cellSize;
+
+    std::vector<Entry> entries; // indexed by actorIndex
+    std::unordered_map<uint64_t, std::vector<ActorId>> cells;
+    std::vector<ActorId> oversized;
+    std::size_t count = 0;
+};
@@ -5,42 +5,92 @@
 #include "avalon/renderer/Shader.hpp"
 #include "avalon/renderer/Sprite.hpp"
 #include "avalon/renderer/Font.hpp"
+#include "avalon/renderer/TextureAtlas.hpp"
 
 #include <nlohmann/json.hpp>
 
 
+/**
+ * Loads every resource of a directory. Loose textures and sprite sheets small enough are packed into
+ * shared atlas pages once all directories are read, so sprites of a level mostly come from one or two
+ * textures: their texture is the page and their texCoords point inside it. getTexture still returns
+ * the image on its own.
+ */
 class ResourceBundle {
 
 public:
+    static constexpr int AtlasPageSize = 2048;
+    static constexpr int AtlasPadding = 2;
+
     ResourceBundle(const std::string &directoryPath) {
 
+        // shaders are submitted first, the driver compiles them while the other resources are read
+        std::filesystem::path shaderPath = std::filesystem::path(directoryPath) / "shaders";
+        if (std::filesystem::is_directory(shaderPath))
+            loadShaders(shaderPath.string());
+
         for (const auto &entry: std::filesystem::directory_iterator(directoryPath)) {
             if (entry.is_directory()) {
                 std::string dirName = entry.path().filename().string();
                 std::string subDirPath = entry.path().string();
 
                 CreateSwitch<std::string>()
-                        .Case("shaders", [this, &subDirPath]() { loadShaders(subDirPath); })
                         .Case("textures", [this, &subDirPath]() { loadTextures(subDirPath); })
                         .Case("spritesheets", [this, &subDirPath]() { loadSprites(subDirPath); })
-                                //.Case("fonts", [this, &subDirPath]() { loadFonts(subDirPath); })
+                        .Case("fonts", [this, &subDirPath]() { loadFonts(subDirPath); })
                         .Default([]() {})
                         .Execute(dirName);
             }
         }
 
+        packAtlas();
+        finishShaders();
     }
 
+    /**
+     * Texture of the image alone, drawn with full texture coordinates. Packed images are loaded as a
+     * texture of their own on first request; draw them with getSprite to use the atlas page instead.
+     */
     Ref<Texture> getTexture(const std::string &filePath) {
-        return textures[filePath];
+        auto it = textures.find(filePath);
+        if (it != textures.end())
+            return it->second;
+
+        auto packed = packedPaths.find(filePath);
+        if (packed == packedPaths.end())
+            return nullptr;
+
+        Ref<Texture> texture = CreateRef<Texture>(packed->second);
+        textures[filePath] = texture;
+        return texture;
     }
 
+    /**
+     * Whole loose texture, with coordinates inside its atlas page if it was packed.
+     */
+    Sprite getSprite(const std::string &name) {
+        auto it = textureSprites.find(name);
+        if (it != textureSprites.end())
+            return it->second;
+
+        return Sprite(getTexture(name));
+    }
+
+    /**
+     * Sprite of a sheet, addressed by the sheet's texture path.
+     */
     Sprite getSprite(const std::string& filePath, int index) {
-        for (auto &x: sprites) {
-            if (x.texture->getFilePath() == filePath && x.index == index) {
-                return x;
-            }
-        }
+        auto it = spriteSheets.find(filePath);
+        if (it != spriteSheets.end() && index >= 0 && index < static_cast<int>(it->second.size()))
+            return it->second[index];
+
+        AV_CORE_WARN("Sprite {0} of {1} not found.", index, filePath);
+        return Sprite(nullptr);
+    }
+
+    Ref<Font> getFont(const std::string &name) {
+        auto it = fonts.find(name);
+        return it != fonts.end() ? it->second : nullptr;
     }
 
     Ref<Shader> getShader(const std::string &name) {
@@ -53,6 +103,12 @@ public:
     }
 
 private:
+    // image waiting for packAtlas, either a loose texture or a sprite sheet
+    struct AtlasEntry {
+        std::string name;
+        std::string path;
+        bool sheet;
+    };
 
     auto loadSpriteTexture(const std::string &resourceName) {
         auto it = textures.find(resourceName);
@@ -66,11 +122,49 @@ private:
     }
 
     void loadShaders(const std::string &directoryPath) {
+        auto start = std::chrono::steady_clock::now();
+        int loaded = 0, cached = 0;
+
         for (const auto &entry: std::filesystem::directory_iterator(directoryPath)) {
             if (entry.is_regular_file()) {
                 std::string shaderName = entry.path().stem().string();
                 Ref<Shader> shader = std::make_shared<Shader>(entry.path().string());
                 shaders[shaderName] = shader;
+
+                loaded++;
+                cached += shader->isFromCache();
+            }
+        }
+
+        // compilation goes on in the driver while the other resources load, see finishShaders
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+        AV_CORE_INFO("Submitted {0} shaders in {1:.1f} ms, {2} from the program cache.", loaded, elapsed.count(), cached);
+    }
+
+    /**
+     * Checks the shaders the driver compiled while textures were decoded. Without parallel compile the
+     * driver cannot be polled and every shader is waited for here; otherwise the ones still compiling
+     * are finished on first use.
+     */
+    void finishShaders() {
+        int finished = 0;
+        for (auto &[name, shader]: shaders) {
+            if (GLExtensions::hasParallelShaderCompile && !shader->isReady())
+                continue;
+
+            shader->finish();
+            finished++;
+        }
+
+        if (finished < static_cast<int>(shaders.size()))
+            AV_CORE_INFO("{0} shaders still compiling, finished on first use.", shaders.size() - finished);
+    }
+
+    void loadFonts(const std::string &directoryPath) {
+        for (const auto &entry: std::filesystem::directory_iterator(directoryPath)) {
+            if (entry.is_regular_file()) {
+                std::string fontName = entry.path().stem().string();
+                fonts[fontName] = CreateRef<Font>(entry.path().string());
             }
         }
     }
@@ -79,12 +173,102 @@ private:
         for (const auto &entry: std::filesystem::directory_iterator(directoryPath)) {
             if (entry.is_regular_file()) {
                 std::string textureName = entry.path().stem().string();
-                Ref<Texture> texture = std::make_shared<Texture>(entry.path().string());
-                textures[textureName] = texture;
+                std::string path = entry.path().string();
+
+                int width, height;
+                if (fitsAtlas(path, width, height)) {
+                    atlasQueue.push_back({textureName, path, false});
+                } else {
+                    Ref<Texture> texture = std::make_shared<Texture>(path);
+                    textures[textureName] = texture;
+                }
             }
         }
     }
 
+    /**
+     * Whether the image is small enough to be packed, half a page at most so that large images do not
+     * take a page each.
+     */
+    static bool fitsAtlas(const std::string &path, int &width, int &height) {
+        int channels;
+        if (!stbi_info(path.c_str(), &width, &height, &channels))
+            return false;
+
+        return width + 2 * AtlasPadding <= AtlasPageSize / 2 && height + 2 * AtlasPadding <= AtlasPageSize / 2;
+    }
+
+    /**
+     * Packs the queued textures and sheets, then points their sprites to the atlas pages.
+     */
+    void packAtlas() {
+        if (atlasQueue.empty())
+            return;
+
+        std::vector<std::unique_ptr<stbi_uc, void (*)(void *)>> pixels;
+        std::vector<TextureAtlas::Image> images;
+        std::vector<const AtlasEntry *> entries;
+
+        std::unordered_set<std::string> queued;
+        for (const auto &entry: atlasQueue) {
+            // a sheet listed twice is packed and remapped once
+            if (!queued.insert(entry.name).second)
+                continue;
+
+            int width, height, channels;
+            stbi_uc *data = stbi_load(entry.path.c_str(), &width, &height, &channels, 4);
+            if (!data) {
+                AV_CORE_ERROR("Error decoding {0} for the atlas, loading it as its own texture.", entry.path);
+                loadUnpacked(entry);
+                continue;
+            }
+
+            pixels.emplace_back(data, stbi_image_free);
+            images.push_back({width, height, data});
+            entries.push_back(&entry);
+        }
+
+        TextureAtlas atlas(AtlasPageSize, AtlasPadding);
+        std::vector<TextureAtlas::Region> regions = atlas.pack(images);
+        std::vector<Ref<Texture>> pages = atlas.createTextures("atlas");
+
+        for (std::size_t i = 0; i < entries.size(); i++) {
+            const TextureAtlas::Region &region = regions[i];
+            const Ref<Texture> &page = pages[region.page];
+            packedPaths[entries[i]->name] = entries[i]->path;
+
+            if (entries[i]->sheet) {
+                for (auto &sprite: spriteSheets[entries[i]->name]) {
+                    sprite.texture = page;
+                    for (auto &coords: sprite.texCoords)
+                        coords = atlas.toPage(region, coords);
+                }
+            } else {
+                Sprite sprite(page);
+                for (auto &coords: sprite.texCoords)
+                    coords = atlas.toPage(region, coords);
+
+                textureSprites[entries[i]->name] = sprite;
+            }
+        }
+
+        AV_CORE_INFO("Packed {0} textures into {1} atlas page(s).", entries.size(), pages.size());
+        atlasQueue.clear();
+    }
+
+    /**
+     * Gives a queued image its own texture, its sprites keep their image-space coordinates.
+     */
+    void loadUnpacked(const AtlasEntry &entry) {
+        Ref<Texture> texture = CreateRef<Texture>(entry.path);
+        textures[entry.name] = texture;
+
+        if (entry.sheet) {
+            for (auto &sprite: spriteSheets[entry.name])
+                sprite.texture = texture;
+        }
+    }
+
     void loadSprites(const std::string &directoryPath) {
         for (const auto &entry: std::filesystem::directory_iterator(directoryPath)) {
             if (entry.is_regular_file() && entry.path().extension() == ".json") {
@@ -139,18 +323,31 @@ private:
             float numY, // number of sprites on y-axis
             float spacing) { // spacing
 
+        if (spriteSheets.contains(textureName)) {
+            AV_CORE_WARN("Sprite sheet {0} is described twice, the first description is kept.", textureName);
+            return;
+        }
+
         Ref<Texture> texture;
         int spriteIndex = 0;
+        int texWidth, texHeight;
 
-        try {
-            texture = loadSpriteTexture(textureName);
-        } catch (const std::exception &exception) {
-            AV_CORE_ERROR("Error opening texture: {0}", textureName);
-            return;
+        // small sheets get their texture once packed, their coordinates are remapped then
+        if (fitsAtlas(textureName, texWidth, texHeight)) {
+            atlasQueue.push_back({textureName, textureName, true});
+        } else {
+            try {
+                texture = loadSpriteTexture(textureName);
+            } catch (const std::exception &exception) {
+                AV_CORE_ERROR("Error opening texture: {0}", textureName);
+                return;
+            }
+
+            texWidth = texture->getWidth();
+            texHeight = texture->getHeight();
         }
 
-        int texWidth = texture->getWidth();
-        int texHeight = texture->getHeight();
+        std::vector<Sprite> &sprites = spriteSheets[textureName];
 
         for (int y = 0; y < numY; y++) {
             for (int x = 0; x < numX; x++) {
@@ -170,7 +367,7 @@ private:
                         glm::vec2(texCoordLeft, texCoordBottom)// Bottom-right
                 };
 
-                this->sprites.emplace_back(texture, texCoords, spriteIndex++);
+                sprites.emplace_back(texture, texCoords, spriteIndex++);
             }
         }
     }
@@ -178,5 +375,9 @@ private:
     std::unordered_map<std::string, Ref<Texture>> textures;
     std::unordered_map<std::string, Ref<Font>> fonts;
     std::unordered_map<std::string, Ref<Shader>> shaders;
-    std::vector<Sprite> sprites;
+    std::unordered_map<std::string, std::vector<Sprite>> spriteSheets; // sheet path -> sprites by index
+    std::unordered_map<std::string, Sprite> textureSprites; // loose texture name -> whole texture
+    std::unordered_map<std::string, std::string> packedPaths; // packed texture or sheet -> image file
+
+    std::vector<AtlasEntry> atlasQueue;
 };
@@ -8,7 +8,7 @@ public:
     void onCreate() override {
 
         this->levelCamera = Camera({0, 0}, 2.0f);
-        this->renderer = Renderer(1000);
+        this->renderer = Renderer(1000, RenderBackend::Instanced);
         this->resourceBundle = AssetPool::getBundle("resources");
     }
 
@@ -18,6 +18,9 @@ public:
 
     void onUpdate(float deltaTime) override {
 
+        registry.advanceTick();
+        systems.run(registry, deltaTime);
+
         if (KEY_PRESSED(GLFW_KEY_D))
             levelCamera.position({deltaTime * 200.0f, 0});
 
@@ -39,6 +42,16 @@ public:
 
 
         renderer.drawQuad({0, 0, 0}, {100, 100}, Color(1.0f, 1.0f, 1.0f, 1.0f), this->resourceBundle->getSprite("resources\\spritesheets\\blocks.png", 0)); // red
+
+        if (auto font = this->resourceBundle->getFont("PixelifySans-Medium"))
+            renderer.drawText({-300, 200, 0}, 32, Color(1.0f, 1.0f, 1.0f, 1.0f), *font, "Avalon\nWASD to move");
+
+        // only actors around the camera are looked at
+        spatialIndex.query(levelCamera.getVisibleMin(), levelCamera.getVisibleMax(), [this](ActorId id) {
+            const RenderComponent *render = registry.getComponent<RenderComponent>(id);
+            if (render->isVisible)
+                renderer.draw(render->position, render->scale, 0.0f, render->shape, render->color, render->sprite.texture, render->sprite.texCoords);
+        });
     }
 
     void onRender(int screenWidth, int screenHeight) override {
@@ -48,6 +61,15 @@ public:
 
         ImGui::Text("World: (%1.f, %1.f)", coords.x, coords.y);
 
+        ActorId hovered = spatialIndex.pick(coords);
+        if (hovered != NullActorId)
+            ImGui::Text("Hovered: actor %u", actorIndex(hovered));
+
+        const RenderStats &stats = renderer.getStats();
+        ImGui::Text("Quads: %u submitted, %u culled, %u drawn", stats.submitted, stats.culled, stats.drawn);
+        ImGui::Text("Draw calls: %u", stats.drawCalls);
+        ImGui::Text("GL state calls: %llu issued, %llu elided", static_cast<unsigned long long>(stats.stateCalls), static_cast<unsigned long long>(stats.stateElided));
+
     }
 
     void onDestroy() override {